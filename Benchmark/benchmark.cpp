@@ -0,0 +1,318 @@
+//
+// Created by allan on 2024/4/21.
+//
+#include "benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+using namespace eve;
+
+/**
+ * Every allocation of the process is counted, the benchmarks report the allocations one operation makes.
+ */
+static std::atomic<uint64_t> allocationCount = 0;
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+/**
+ * Every operator delete, sized or not, frees through here. Not inlined, so the compiler does not see free() called
+ * on memory from operator new and warn about a mismatch.
+ */
+[[gnu::noinline]] static void releaseMemory(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory) noexcept {
+    releaseMemory(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    releaseMemory(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    releaseMemory(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    releaseMemory(memory);
+}
+
+struct BenchmarkOptions {
+    std::vector<SIZE_T> heapMegabytes = {256};
+    SIZE_T repetitions = 5;
+    uint8_t threads = 4;
+    uint32_t treeDepth = 5;
+    uint32_t treeFanOut = 4;
+    std::string filter;
+};
+
+/**
+ * What one run of a benchmark did: bytes scanned or read and items (candidates, nodes, reads) processed.
+ */
+struct BenchmarkWork {
+    SIZE_T bytes = 0;
+    SIZE_T items = 0;
+};
+
+/**
+ * Runs `operation` once to warm up, then `repetitions` times, and prints the median run.
+ */
+template<class F>
+static void runBenchmark(const BenchmarkOptions &options, const std::string &name, F &&operation) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    operation();
+    std::vector<double> seconds;
+    std::vector<uint64_t> allocations;
+    BenchmarkWork work;
+    for (SIZE_T i = 0; i < options.repetitions; i++) {
+        auto allocationsBefore = allocationCount.load();
+        auto begin = std::chrono::steady_clock::now();
+        work = operation();
+        auto end = std::chrono::steady_clock::now();
+        allocations.push_back(allocationCount.load() - allocationsBefore);
+        seconds.push_back(std::chrono::duration<double>(end - begin).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    std::sort(allocations.begin(), allocations.end());
+    auto median = seconds[seconds.size() / 2];
+    auto gigabytesPerSecond = work.bytes == 0 ? 0.0 : (double) work.bytes / median / 1e9;
+    auto nanosecondsPerItem = work.items == 0 ? 0.0 : median * 1e9 / (double) work.items;
+    auto allocationsPerItem = work.items == 0 ? 0.0 : (double) allocations[allocations.size() / 2] / (double) work.items;
+    std::cout << std::format("{:<36} {:>12.3f} ms {:>10.3f} GB/s {:>12.1f} ns/item {:>10.3f} allocs/item {:>10} items\n",
+                             name, median * 1e3, gigabytesPerSecond, nanosecondsPerItem, allocationsPerItem,
+                             work.items);
+}
+
+/**
+ * Exposes the discovery stages and the scan chunking to the benchmarks.
+ */
+class BenchmarkReader : public EVEOnlineReader {
+public:
+    using EVEOnlineReader::EVEOnlineReader;
+
+    [[nodiscard]] inline SIZE_T committedBytes() const {
+        SIZE_T bytes = 0;
+        for (auto &[_, region]: *committedRegions) {
+            bytes += region->regionSize;
+        }
+        return bytes;
+    }
+
+    inline SIZE_T scanTypeTypes() {
+        EnumerateCandidatesForPythonTypes();
+        return pythonTypes->size();
+    }
+
+    inline SIZE_T scanBuiltinTypes() {
+        auto candidates = EnumerateCandidatesForPythonObjectsByTypeName(
+                [this](uint64_t *ob_type) {
+                    return pythonTypes->contains(ob_type);
+                },
+                builtinTypeNames,
+                committedRegions
+        );
+        SIZE_T found = 0;
+        for (auto &bucket: candidates) {
+            found += bucket.size();
+        }
+        return found;
+    }
+};
+
+static std::vector<PVOID> randomAddresses(const SyntheticHeap &heap, SIZE_T count, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    auto regions = heap.regions();
+    std::vector<PVOID> addresses;
+    addresses.reserve(count);
+    for (SIZE_T i = 0; i < count; i++) {
+        auto &region = regions[random() % regions.size()];
+        addresses.push_back((LPBYTE) region.baseAddress + random() % (region.regionSize - 64) / 8 * 8);
+    }
+    return addresses;
+}
+
+static void runMicroBenchmarks(const BenchmarkOptions &options, const std::shared_ptr<SyntheticHeap> &heap,
+                               BenchmarkReader &reader, const std::string &suffix) {
+    auto addresses = randomAddresses(*heap, 1 << 20, 7);
+    runBenchmark(options, "readCachedBytes" + suffix, [&] {
+        for (auto address: addresses) {
+            reader.readCachedBytes(address, 64);
+        }
+        return BenchmarkWork{addresses.size() * 64, addresses.size()};
+    });
+    runBenchmark(options, "readCachedSpan" + suffix, [&] {
+        SIZE_T bytes = 0;
+        for (auto address: addresses) {
+            bytes += reader.readCachedSpan(address, 64).size();
+        }
+        return BenchmarkWork{bytes, addresses.size()};
+    });
+
+    auto lookups = addresses;
+    std::mt19937_64 random(11);
+    for (auto &address: lookups) {
+        // Half of the lookups miss, either before, between or after the regions.
+        if (random() % 2 == 0) {
+            address = (PVOID) (random() % (SyntheticHeap::fillerBase + heap->totalBytes() * 2));
+        }
+    }
+    runBenchmark(options, "regionLookup" + suffix, [&] {
+        SIZE_T hits = 0;
+        for (auto address: lookups) {
+            hits += reader.isCachedAddress(address);
+        }
+        return BenchmarkWork{0, lookups.size()};
+    });
+
+    // The scan kernels on a plain buffer, without any reader around them.
+    std::vector<uint64_t> words(std::min<SIZE_T>(heap->totalBytes(), 256ull * 1024 * 1024) / sizeof(uint64_t));
+    heap->read((PVOID) SyntheticHeap::fillerBase, words.data(), words.size() * sizeof(uint64_t));
+    std::vector<SIZE_T> hits;
+    hits.reserve(1024);
+    runBenchmark(options, "typeScanKernel.scalar" + suffix, [&] {
+        hits.clear();
+        kernels::findSelfReferencesScalar(words.data(), 0, words.size() - 1, SyntheticHeap::fillerBase, hits);
+        return BenchmarkWork{words.size() * sizeof(uint64_t), words.size()};
+    });
+    const char *kernelName = nullptr;
+    auto kernel = kernels::selectSelfReferenceScan(&kernelName);
+    runBenchmark(options, std::format("typeScanKernel.{}{}", kernelName, suffix), [&] {
+        hits.clear();
+        kernel(words.data(), 0, words.size() - 1, SyntheticHeap::fillerBase, hits);
+        return BenchmarkWork{words.size() * sizeof(uint64_t), words.size()};
+    });
+
+    auto scannedBytes = reader.committedBytes();
+    runBenchmark(options, "typeScan" + suffix, [&] {
+        return BenchmarkWork{scannedBytes, reader.scanTypeTypes()};
+    });
+    auto typeType = (uint64_t *) heap->getTypeType();
+    runBenchmark(options, "objectScan.typeObjects" + suffix, [&] {
+        auto candidates = reader.EnumerateCandidatesForPythonObjects(
+                [typeType](uint64_t *ob_type) {
+                    return ob_type == typeType;
+                },
+                [](std::string_view) {
+                    return true;
+                }
+        );
+        return BenchmarkWork{scannedBytes, candidates->size()};
+    });
+    runBenchmark(options, "objectScan.builtinTypes" + suffix, [&] {
+        return BenchmarkWork{scannedBytes, reader.scanBuiltinTypes()};
+    });
+
+    auto &strings = heap->getStrings();
+    runBenchmark(options, "readPythonStrView" + suffix, [&] {
+        SIZE_T bytes = 0;
+        for (auto address: strings) {
+            bytes += reader.readPythonStrView(address).size();
+        }
+        return BenchmarkWork{bytes, strings.size()};
+    });
+    runBenchmark(options, "readPythonTextView" + suffix, [&] {
+        SIZE_T bytes = 0;
+        for (auto address: strings) {
+            bytes += reader.readPythonTextView(address).size();
+        }
+        return BenchmarkWork{bytes, strings.size()};
+    });
+    PyValue value;
+    PyValueBuffer buffer;
+    runBenchmark(options, "decodePythonValue.str" + suffix, [&] {
+        buffer.clear();
+        for (auto address: strings) {
+            reader.decodePythonValue(address, value, buffer);
+        }
+        return BenchmarkWork{buffer.stringPool.size(), strings.size()};
+    });
+}
+
+static void runMacroBenchmarks(const BenchmarkOptions &options, const std::shared_ptr<SyntheticHeap> &heap,
+                               BenchmarkReader &reader, const std::string &suffix) {
+    runBenchmark(options, "discovery.eager" + suffix, [&] {
+        BenchmarkReader discovered(std::make_unique<SyntheticMemorySource>(heap), options.threads);
+        return BenchmarkWork{heap->totalBytes(), 1};
+    });
+    runBenchmark(options, "discovery.lazy" + suffix, [&] {
+        BenchmarkReader discovered(std::make_unique<SyntheticMemorySource>(heap), options.threads, nullptr,
+                                   CacheOptions{.lazy = true});
+        return BenchmarkWork{heap->totalBytes(), 1};
+    });
+    UITree tree;
+    runBenchmark(options, "uiTree" + suffix, [&] {
+        reader.readUITree(tree);
+        return BenchmarkWork{0, tree.size()};
+    });
+    UITreeDelta delta;
+    runBenchmark(options, "uiTreeDelta.unchanged" + suffix, [&] {
+        auto &current = reader.readUITreeDelta(delta);
+        return BenchmarkWork{0, current.size()};
+    });
+}
+
+static BenchmarkOptions parseOptions(int argc, char *argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view name = argv[i];
+        std::string value = argv[i + 1];
+        if (name == "--heap-mb") {
+            options.heapMegabytes.clear();
+            std::istringstream sizes(value);
+            for (std::string size; std::getline(sizes, size, ',');) {
+                options.heapMegabytes.push_back(std::stoull(size));
+            }
+        } else if (name == "--repetitions") {
+            options.repetitions = std::max<SIZE_T>(std::stoull(value), 1);
+        } else if (name == "--threads") {
+            options.threads = (uint8_t) std::stoul(value);
+        } else if (name == "--depth") {
+            options.treeDepth = std::stoul(value);
+        } else if (name == "--fan-out") {
+            options.treeFanOut = std::stoul(value);
+        } else if (name == "--filter") {
+            options.filter = value;
+        } else {
+            std::cerr << std::format("unknown option {}\n", name);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_preamble_header = false;
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    auto options = parseOptions(argc, argv);
+    loguru::init(argc, argv);
+    for (auto heapMegabytes: options.heapMegabytes) {
+        auto heap = std::make_shared<SyntheticHeap>(SyntheticHeapOptions{
+                .heapBytes = heapMegabytes * 1024 * 1024,
+                .treeDepth = options.treeDepth,
+                .treeFanOut = options.treeFanOut
+        });
+        auto suffix = std::format("/{}MB", heapMegabytes);
+        std::cout << std::format("synthetic heap: {} MB, {} UI nodes, {} threads\n",
+                                 heap->totalBytes() / 1024 / 1024, heap->getUINodeCount(), (int) options.threads);
+        BenchmarkReader reader(std::make_unique<SyntheticMemorySource>(heap), options.threads);
+        runMicroBenchmarks(options, heap, reader, suffix);
+        runMacroBenchmarks(options, heap, reader, suffix);
+    }
+    return 0;
+}
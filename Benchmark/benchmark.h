@@ -0,0 +1,17 @@
+//
+// Created by allan on 2024/4/21.
+//
+
+#pragma once
+
+#define LOGURU_WITH_STREAMS 1
+
+#include <iostream>
+#include <sstream>
+#include "loguru.hpp"
+#include <vector>
+#include <chrono>
+#include <map>
+#include <format>
+#include "EVEOnlineReader.h"
+#include "SyntheticHeap.h"
@@ -3,3 +3,172 @@
 //
 
 #include "sanderling.h"
+
+using namespace eve;
+
+/**
+ * {stage: {"calls": ..., "nanoseconds": ..., counter: ...}}, keyed by readerStageNames and stageCounterNames.
+ */
+static py::dict statsToDict(const ReaderStats &stats) {
+    py::dict stages;
+    for (SIZE_T stage = 0; stage < stats.stages.size(); stage++) {
+        auto &stageStats = stats.stages[stage];
+        py::dict counters;
+        counters["calls"] = stageStats.calls;
+        counters["nanoseconds"] = stageStats.nanoseconds;
+        for (SIZE_T counter = 0; counter < stageStats.counters.size(); counter++) {
+            counters[py::str(stageCounterNames[counter])] = stageStats.counters[counter];
+        }
+        stages[py::str(readerStageNames[stage])] = counters;
+    }
+    return stages;
+}
+
+static py::dict diffToDict(const CacheDiff &diff) {
+    py::dict summary;
+    summary["added_regions"] = diff.addedRegions.size();
+    summary["removed_regions"] = diff.removedRegions.size();
+    summary["resized_regions"] = diff.resizedRegions.size();
+    summary["changed_pages"] = diff.changedPages.size();
+    return summary;
+}
+
+static CacheOptions makeCacheOptions(bool lazy, bool collectStats, const std::string &discoveryCacheDirectory) {
+    CacheOptions options;
+    options.lazy = lazy;
+    options.collectStats = collectStats;
+    options.discoveryCacheDirectory = discoveryCacheDirectory;
+    return options;
+}
+
+PYBIND11_MODULE(pysanderling, m) {
+    py::class_<BufferView>(m, "BufferView", py::buffer_protocol())
+            .def_buffer([](const BufferView &view) {
+                return view.info();
+            });
+
+    py::class_<UITreeView>(m, "UITree")
+            .def("__len__", &UITreeView::size)
+            .def_property_readonly("address", &UITreeView::addresses)
+            .def_property_readonly("parent", [](const UITreeView &view) {
+                return view.column(view.tree->parent);
+            })
+            .def_property_readonly("depth", [](const UITreeView &view) {
+                return view.column(view.tree->depth);
+            })
+            .def_property_readonly("type_id", [](const UITreeView &view) {
+                return view.column(view.tree->typeId);
+            })
+            .def_property_readonly("display_x", [](const UITreeView &view) {
+                return view.column(view.tree->displayX);
+            })
+            .def_property_readonly("display_y", [](const UITreeView &view) {
+                return view.column(view.tree->displayY);
+            })
+            .def_property_readonly("display_width", [](const UITreeView &view) {
+                return view.column(view.tree->displayWidth);
+            })
+            .def_property_readonly("display_height", [](const UITreeView &view) {
+                return view.column(view.tree->displayHeight);
+            })
+            .def_property_readonly("name", [](const UITreeView &view) {
+                return view.strings(view.tree->name);
+            })
+            .def_property_readonly("text", [](const UITreeView &view) {
+                return view.strings(view.tree->text);
+            })
+            .def_property_readonly("hint", [](const UITreeView &view) {
+                return view.strings(view.tree->hint);
+            })
+            .def_property_readonly("string_pool", &UITreeView::stringPool)
+            .def_property_readonly("type_names", [](const UITreeView &view) {
+                return view.tree->typeNames;
+            })
+            .def("name_of", [](const UITreeView &view, SIZE_T row) {
+                return view.string(view.tree->name, row);
+            }, py::arg("row"))
+            .def("text_of", [](const UITreeView &view, SIZE_T row) {
+                return view.string(view.tree->text, row);
+            }, py::arg("row"))
+            .def("hint_of", [](const UITreeView &view, SIZE_T row) {
+                return view.string(view.tree->hint, row);
+            }, py::arg("row"));
+
+    py::class_<UITreeDelta, std::shared_ptr<UITreeDelta>>(m, "UITreeDelta")
+            .def("__bool__", [](const UITreeDelta &delta) {
+                return !delta.empty();
+            })
+            .def_property_readonly("added", [](const std::shared_ptr<UITreeDelta> &delta) {
+                return BufferView::of(delta, delta->added.data(), delta->added.size());
+            })
+            .def_property_readonly("removed", [](const std::shared_ptr<UITreeDelta> &delta) {
+                return BufferView::of(delta, (const uint64_t *) delta->removed.data(), delta->removed.size());
+            })
+            .def_property_readonly("changed", [](const std::shared_ptr<UITreeDelta> &delta) {
+                return BufferView::of(delta, delta->changed.data(), delta->changed.size());
+            })
+            .def_property_readonly("changed_properties", [](const std::shared_ptr<UITreeDelta> &delta) {
+                return BufferView::of(delta, delta->changedProperties.data(), delta->changedProperties.size());
+            })
+            .def_readonly("decoded_nodes", &UITreeDelta::decodedNodes)
+            .def_readonly("reused_nodes", &UITreeDelta::reusedNodes);
+
+    py::class_<SharedFrameSubscriber>(m, "FrameSubscriber")
+            .def(py::init([](const std::string &name) {
+                return std::make_unique<SharedFrameSubscriber>(SharedMemorySegment::open(name));
+            }), py::arg("name"))
+            .def("is_valid", &SharedFrameSubscriber::isValid)
+            .def("latest_sequence", &SharedFrameSubscriber::latestSequence)
+            .def("read_latest", [](const SharedFrameSubscriber &subscriber)
+                    -> std::optional<std::pair<uint64_t, UITreeView>> {
+                // Python cannot re-validate a seqlock slot after using it, the frame is copied out once.
+                auto tree = std::make_shared<UITree>();
+                uint64_t sequence;
+                {
+                    py::gil_scoped_release release;
+                    sequence = subscriber.copyLatest(*tree);
+                }
+                if (sequence == 0) {
+                    return std::nullopt;
+                }
+                return std::make_pair(sequence, UITreeView(std::move(tree)));
+            });
+
+    py::class_<sanderling>(m, "EVEOnlineReader")
+            .def(py::init([](DWORD pid, uint8_t threads, bool lazy, bool collectStats,
+                             const std::string &discoveryCacheDirectory) {
+                     return std::make_unique<sanderling>(ProcessMemoryReader::openProcessMemorySource(pid), threads,
+                                                         makeCacheOptions(lazy, collectStats,
+                                                                          discoveryCacheDirectory));
+                 }), py::arg("pid"), py::arg("threads") = 4, py::arg("lazy") = false,
+                 py::arg("collect_stats") = false, py::arg("discovery_cache_directory") = "")
+            .def_static("from_snapshot", [](const std::string &path, uint8_t threads, bool collectStats) {
+                return std::make_unique<sanderling>(std::make_unique<SnapshotMemorySource>(path), threads,
+                                                    makeCacheOptions(false, collectStats, ""));
+            }, py::arg("path"), py::arg("threads") = 4, py::arg("collect_stats") = false)
+            .def_static("synthetic", [](SIZE_T heapMegabytes, uint8_t threads, bool lazy, bool collectStats) {
+                auto heap = std::make_shared<SyntheticHeap>(SyntheticHeapOptions{
+                        .heapBytes = heapMegabytes * 1024 * 1024});
+                return std::make_unique<sanderling>(std::make_unique<SyntheticMemorySource>(std::move(heap)),
+                                                    threads, makeCacheOptions(lazy, collectStats, ""));
+            }, py::arg("heap_mb") = 64, py::arg("threads") = 4, py::arg("lazy") = false,
+                        py::arg("collect_stats") = false)
+            .def("refresh_cache", [](sanderling &reader) {
+                return diffToDict(reader.refreshCache());
+            })
+            .def("refresh_object_regions", [](sanderling &reader) {
+                return diffToDict(reader.refreshObjectRegions());
+            })
+            .def("reload_cache", &sanderling::reloadCache)
+            .def("save_snapshot", &sanderling::saveSnapshot, py::arg("path"))
+            .def("regions", &sanderling::regions)
+            .def("region", &sanderling::region, py::arg("base_address"))
+            .def("read_ui_tree", &sanderling::readUITree, py::arg("max_depth") = 64, py::arg("max_nodes") = 1 << 16)
+            .def("read_ui_tree_delta", &sanderling::readUITreeDelta, py::arg("max_depth") = 64,
+                 py::arg("max_nodes") = 1 << 16)
+            .def("stats", [](const sanderling &reader) {
+                return statsToDict(reader.stats());
+            })
+            .def("reset_stats", &sanderling::resetStats)
+            .def("set_stats_enabled", &sanderling::setStatsEnabled, py::arg("enabled"));
+}
@@ -5,12 +5,221 @@
 #ifndef EVEONLINE_HELPER_SANDERLING_H
 #define EVEONLINE_HELPER_SANDERLING_H
 
+#define LOGURU_WITH_STREAMS 1
+
 #undef _DEBUG
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #define _DEBUG
 
+#include "loguru.hpp"
+#include "sanderling_api.h"
+
+namespace py = pybind11;
+
+/**
+ * Read-only memory shared with Python through the buffer protocol: memoryview() and numpy.asarray() use it in
+ * place. `owner` keeps the memory alive as long as any view of it exists.
+ */
+struct BufferView {
+    std::shared_ptr<const void> owner;
+    const void *data = nullptr;
+    py::ssize_t itemSize = 1;
+    std::string format;
+    std::vector<py::ssize_t> shape;
+
+    [[nodiscard]] inline py::buffer_info info() const {
+        std::vector<py::ssize_t> strides(shape.size());
+        auto stride = itemSize;
+        for (auto i = shape.size(); i-- > 0;) {
+            strides[i] = stride;
+            stride *= shape[i];
+        }
+        // Empty vectors have no data pointer, the buffer protocol wants one anyway.
+        static const uint64_t empty = 0;
+        auto pointer = data != nullptr ? data : &empty;
+        return {const_cast<void *>(pointer), itemSize, format, (py::ssize_t) shape.size(), shape, strides, true};
+    }
+
+    template<class T>
+    static inline BufferView of(std::shared_ptr<const void> owner, const T *data, SIZE_T count) {
+        return {std::move(owner), data, sizeof(T), py::format_descriptor<T>::format(), {(py::ssize_t) count}};
+    }
+};
+
+/**
+ * A UITree owned by Python, its columns are exported without copying. StringRef columns come out as (row, 2)
+ * arrays of offset and length into `string_pool`.
+ */
+class UITreeView {
+public:
+    explicit UITreeView(std::shared_ptr<const eve::UITree> tree) : tree(std::move(tree)) {}
+
+    [[nodiscard]] inline SIZE_T size() const {
+        return tree->size();
+    }
+
+    template<class T>
+    [[nodiscard]] inline BufferView column(const std::vector<T> &values) const {
+        return BufferView::of(tree, values.data(), values.size());
+    }
+
+    [[nodiscard]] inline BufferView addresses() const {
+        return BufferView::of(tree, (const uint64_t *) tree->address.data(), tree->address.size());
+    }
+
+    [[nodiscard]] inline BufferView strings(const std::vector<eve::StringRef> &refs) const {
+        static_assert(sizeof(eve::StringRef) == 2 * sizeof(uint32_t));
+        return {tree, refs.data(), sizeof(uint32_t), py::format_descriptor<uint32_t>::format(),
+                {(py::ssize_t) refs.size(), 2}};
+    }
+
+    [[nodiscard]] inline BufferView stringPool() const {
+        return BufferView::of(tree, (const uint8_t *) tree->stringPool.data(), tree->stringPool.size());
+    }
+
+    /**
+     * The string at `row` of a StringRef column, decoded as UTF-8. py2 str texts are not always valid UTF-8, bad
+     * bytes become U+FFFD.
+     */
+    [[nodiscard]] inline py::str string(const std::vector<eve::StringRef> &refs, SIZE_T row) const {
+        if (row >= refs.size()) {
+            throw py::index_error(std::format("row {} out of range", row));
+        }
+        auto text = tree->string(refs[row]);
+        return py::reinterpret_steal<py::str>(PyUnicode_DecodeUTF8(text.data(), (py::ssize_t) text.size(),
+                                                                   "replace"));
+    }
+
+    std::shared_ptr<const eve::UITree> tree;
+};
+
+/**
+ * An EVEOnlineReader for Python. Everything that scans or walks the tree runs with the GIL released, so calls from
+ * several Python threads are serialized by `mutex`, always taken after the GIL is released.
+ */
 class sanderling {
+public:
+    sanderling(eve::PMS source, uint8_t numThreads, eve::CacheOptions cacheOptions) {
+        py::gil_scoped_release release;
+        reader = std::make_shared<eve::EVEOnlineReader>(std::move(source), numThreads, nullptr,
+                                                        std::move(cacheOptions));
+    }
+
+    inline eve::CacheDiff refreshCache() {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        return reader->refreshCache();
+    }
+
+    inline eve::CacheDiff refreshObjectRegions() {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        return reader->refreshObjectRegions();
+    }
+
+    /**
+     * reloadCache() remaps the region arena under any exported region, so it refuses while one is still alive.
+     */
+    inline void reloadCache() {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        if (regionExports.use_count() > 1) {
+            throw std::runtime_error("release the region views before reload_cache()");
+        }
+        reader->reloadCache();
+    }
+
+    inline bool saveSnapshot(const std::string &path) const {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        return reader->saveSnapshot(path);
+    }
+
+    /**
+     * Base address and size of every committed region.
+     */
+    [[nodiscard]] inline std::vector<std::pair<uint64_t, SIZE_T>> regions() const {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        std::vector<std::pair<uint64_t, SIZE_T>> regions;
+        for (auto &[baseAddress, region]: reader->getCommittedRegions()) {
+            regions.emplace_back((uint64_t) baseAddress, region->regionSize);
+        }
+        return regions;
+    }
+
+    /**
+     * The content of the region at `baseAddress`, nullopt for unknown, unreadable and on-demand regions.
+     */
+    [[nodiscard]] inline std::optional<BufferView> region(uint64_t baseAddress) const {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        auto &regions = reader->getCommittedRegions();
+        auto entry = regions.find((PVOID) baseAddress);
+        if (entry == regions.end() || entry->second->content.empty()) {
+            return std::nullopt;
+        }
+        auto &content = entry->second->content;
+        auto owner = std::make_shared<RegionExport>(RegionExport{reader, entry->second, regionExports});
+        return BufferView::of(std::move(owner), (const uint8_t *) content.data(), content.size());
+    }
+
+    [[nodiscard]] inline UITreeView readUITree(SIZE_T maxDepth, SIZE_T maxNodes) {
+        auto tree = std::make_shared<eve::UITree>();
+        {
+            py::gil_scoped_release release;
+            std::lock_guard lock(mutex);
+            reader->readUITree(*tree, maxDepth, maxNodes);
+        }
+        return UITreeView(std::move(tree));
+    }
+
+    /**
+     * readUITreeDelta(). The reader reuses its frames, so the tree handed to Python is a copy of the columns,
+     * still far cheaper than building Python objects per node.
+     */
+    [[nodiscard]] inline std::pair<UITreeView, std::shared_ptr<eve::UITreeDelta>> readUITreeDelta(SIZE_T maxDepth,
+                                                                                                  SIZE_T maxNodes) {
+        auto delta = std::make_shared<eve::UITreeDelta>();
+        std::shared_ptr<eve::UITree> tree;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard lock(mutex);
+            tree = std::make_shared<eve::UITree>(reader->readUITreeDelta(*delta, maxDepth, maxNodes));
+        }
+        return {UITreeView(std::move(tree)), std::move(delta)};
+    }
+
+    [[nodiscard]] inline eve::ReaderStats stats() const {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        return reader->getStats();
+    }
+
+    inline void resetStats() {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        reader->resetStats();
+    }
+
+    inline void setStatsEnabled(bool enabled) {
+        py::gil_scoped_release release;
+        std::lock_guard lock(mutex);
+        reader->setStatsEnabled(enabled);
+    }
+
+private:
+    struct RegionExport {
+        std::shared_ptr<const eve::EVEOnlineReader> reader;
+        eve::SPMR region;
+        std::shared_ptr<const void> token;
+    };
 
+    std::shared_ptr<eve::EVEOnlineReader> reader;
+    mutable std::mutex mutex;
+    // Held by every exported region, see reloadCache().
+    std::shared_ptr<const void> regionExports = std::make_shared<int>(0);
 };
 
 
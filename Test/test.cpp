@@ -4,6 +4,561 @@
 
 using namespace loguru;
 
+static bool check(bool condition, std::string_view what)
+{
+    if (!condition) {
+        LOG_S(ERROR) << std::format("FAILED: {}", what);
+    }
+    return condition;
+}
+
+/**
+ * One writable region of bytes, for the checks that need to control the memory they read.
+ */
+class BufferMemorySource : public eve::ProcessMemorySource {
+public:
+    BufferMemorySource(uint64_t baseAddress, std::vector<byte> bytes) : baseAddress(baseAddress), bytes(std::move(bytes)) {}
+
+    [[nodiscard]] bool isOpen() const override { return open; }
+
+    [[nodiscard]] DWORD processId() const override { return 1; }
+
+    [[nodiscard]] std::vector<eve::MemoryRegionInfo> enumerateReadableRegions() const override
+    {
+        return {{(PVOID)baseAddress, bytes.size()}};
+    }
+
+    SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const override
+    {
+        reads += 1;
+        auto offset = (uint64_t)address - baseAddress;
+        if ((uint64_t)address < baseAddress || offset >= bytes.size()) {
+            return 0;
+        }
+        length = std::min<SIZE_T>(length, bytes.size() - offset);
+        std::memcpy(buffer, bytes.data() + offset, length);
+        return length;
+    }
+
+    uint64_t baseAddress;
+    std::vector<byte> bytes;
+    bool open = true;
+    mutable std::atomic<SIZE_T> reads = 0;
+};
+
+static bool checkWorkerPool()
+{
+    auto passed = true;
+    eve::WorkerPool pool(2);
+    std::atomic<SIZE_T> calls = 0;
+    std::string message;
+    try {
+        pool.parallelFor(100, [&calls](SIZE_T i) {
+            calls += 1;
+            if (i == 37) {
+                throw std::runtime_error("body 37");
+            }
+        });
+    } catch (const std::runtime_error& error) {
+        message = error.what();
+    }
+    passed &= check(message == "body 37" && calls == 100, "parallelFor rethrows after running every index");
+    // More outer calls than threads, so every worker blocks in an inner call while others are queued.
+    std::atomic<SIZE_T> sum = 0;
+    pool.parallelFor(8, [&pool, &sum](SIZE_T i) {
+        pool.parallelFor(8, [i, &sum](SIZE_T j) { sum += i * 8 + j; });
+    });
+    passed &= check(sum == 64 * 63 / 2, "nested parallelFor");
+    std::vector<std::future<SIZE_T>> futures;
+    for (SIZE_T i = 0; i < 64; i++) {
+        futures.push_back(pool.submit([i] { return i * i; }));
+    }
+    SIZE_T squares = 0;
+    for (auto& future : futures) {
+        squares += future.get();
+    }
+    passed &= check(squares == 63 * 64 * 127 / 6, "submit futures");
+    auto failing = pool.submit([]() -> int { throw std::runtime_error("submitted"); });
+    message.clear();
+    try {
+        failing.get();
+    } catch (const std::runtime_error& error) {
+        message = error.what();
+    }
+    passed &= check(message == "submitted", "submit future carries the exception");
+    return passed;
+}
+
+static bool checkLazyCacheReuse()
+{
+    auto passed = true;
+    BufferMemorySource first(0x10000, std::vector<byte>(64 * 1024, 0x11));
+    BufferMemorySource second(0x10000, std::vector<byte>(64 * 1024, 0x22));
+    eve::RegionIndexEntry region{0x10000, 64 * 1024, nullptr};
+    std::optional<eve::LazyRegionCache> cache;
+    cache.emplace(first, 4096, 1 << 20);
+    auto address = &*cache;
+    passed &= check(cache->view(region, 0, 16)[0] == 0x11, "first cache read");
+    cache.reset();
+    cache.emplace(second, 4096, 1 << 20);
+    passed &= check(&*cache == address && cache->view(region, 0, 16)[0] == 0x22,
+                    "new cache at the same address does not serve the old pins");
+    return passed;
+}
+
+static bool checkPageChanges()
+{
+    auto passed = true;
+    std::vector<byte> bytes(16 * eve::cachePageSize);
+    for (SIZE_T i = 0; i < bytes.size(); i++) {
+        bytes[i] = (byte)(i * 131 + (i >> 12));
+    }
+    auto owned = std::make_unique<BufferMemorySource>(0x10000, bytes);
+    auto source = owned.get();
+    eve::ProcessMemoryReader reader(std::move(owned), 2);
+    passed &= check(reader.refreshCache().empty(), "unchanged pages give an empty diff");
+    // Bit 63 of two words of the same lane, which a hash without avalanche cancels out.
+    auto page = source->bytes.data() + 5 * eve::cachePageSize;
+    page[7] ^= 0x80;
+    page[32 + 7] ^= 0x80;
+    auto diff = reader.refreshCache();
+    passed &= check(!diff.hasLayoutChanges() && diff.changedPages.size() == 1
+                    && diff.changedPages[0].address == (PVOID)(0x10000 + 5 * eve::cachePageSize)
+                    && diff.changedPages[0].length == eve::cachePageSize,
+                    "the changed page is reported, only that one");
+    passed &= check(reader.refreshCache().empty(), "page hashes updated after the refresh");
+    return passed;
+}
+
+static bool checkSnapshotRoundTrip()
+{
+    auto passed = true;
+    std::vector<byte> bytes(3 * eve::cachePageSize + 100);
+    for (SIZE_T i = 0; i < bytes.size(); i++) {
+        bytes[i] = (byte)(i * 7);
+    }
+    auto path = (std::filesystem::temp_directory_path() / std::format("sanderling-test-{}.snap", getpid())).string();
+    {
+        eve::ProcessMemoryReader reader(std::make_unique<BufferMemorySource>(0x10000, bytes), 2);
+        passed &= check(reader.saveSnapshot(path), "snapshot written");
+    }
+    {
+        eve::SnapshotMemorySource snapshot(path);
+        auto regions = snapshot.enumerateReadableRegions();
+        std::vector<byte> content(bytes.size());
+        passed &= check(snapshot.isOpen() && regions.size() == 1 && regions[0].baseAddress == (PVOID)0x10000
+                        && regions[0].regionSize == bytes.size()
+                        && snapshot.read((PVOID)0x10000, content.data(), content.size()) == bytes.size()
+                        && content == bytes,
+                        "snapshot read back");
+        passed &= check(snapshot.read((PVOID)(0x10000 + bytes.size()), content.data(), 1) == 0,
+                        "no read past the snapshot regions");
+    }
+    {
+        // A region count whose table size wraps around to the header size.
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t regionCount = 1ull << 61;
+        file.seekp(offsetof(eve::SnapshotHeader, regionCount));
+        file.write((const char*)&regionCount, sizeof(regionCount));
+    }
+    passed &= check(!eve::SnapshotMemorySource(path).isOpen(), "corrupt snapshot rejected");
+    std::filesystem::remove(path);
+    return passed;
+}
+
+static bool checkReadPlanner()
+{
+    auto passed = true;
+    const uint64_t base = 0x10000, page = eve::cachePageSize;
+    BufferMemorySource source(base, std::vector<byte>(16 * page));
+    for (SIZE_T i = 0; i < source.bytes.size(); i++) {
+        source.bytes[i] = (byte)(i * 13 + (i >> 8));
+    }
+    auto expected = [&source, base](uint64_t address, SIZE_T length) {
+        auto begin = source.bytes.begin() + (address - base);
+        return std::vector<byte>(begin, begin + length);
+    };
+    eve::ReadPlanner planner;
+    // Out of order. Pages 0, 1 and 3 merge across the one page gap, 12 stays apart, 15 merges with a read past
+    // the end of the source, which makes that span fall back to single reads.
+    std::vector<std::pair<uint64_t, SIZE_T>> requests{
+            {base + 3 * page + 10, 8}, {base + 16, 32}, {base + page + 100, 50}, {base + 12 * page, 16},
+            {base + 16 * page - 8, 8}, {base + 16 * page + 8, 8}};
+    std::vector<SIZE_T> handles;
+    for (auto [address, length] : requests) {
+        handles.push_back(planner.add((PVOID)address, length));
+    }
+    planner.execute(source);
+    passed &= check(planner.spanCount() == 3 && planner.getFallbackReads() == 2,
+                    std::format("{} spans, {} fallback reads", planner.spanCount(), planner.getFallbackReads()));
+    for (SIZE_T i = 0; i + 1 < requests.size(); i++) {
+        auto view = planner.view(handles[i]);
+        passed &= check(std::vector<byte>(view.begin(), view.end()) == expected(requests[i].first, requests[i].second),
+                        "planned read matches the source");
+    }
+    passed &= check(planner.view(handles.back()).empty(), "unreadable request gives an empty view");
+    planner.clear();
+    passed &= check(planner.requestCount() == 0 && planner.spanCount() == 0, "planner cleared");
+    // Blocks 0 to 2 merge into one read, block 5 is apart. Afterwards every view is served from the cache.
+    eve::LazyRegionCache cache(source, page, 1 << 20);
+    eve::RegionIndexEntry region{base, source.bytes.size(), nullptr};
+    std::vector<eve::PageRange> ranges{{(PVOID)(base + 100), 8}, {(PVOID)(base + page - 4), 2 * page},
+                                       {(PVOID)(base + 5 * page), 16}, {(PVOID)(base + 20 * page), 16}};
+    source.reads = 0;
+    cache.prefetch(ranges, [&region](uint64_t address) {
+        return address < region.baseAddress + region.size ? &region : nullptr;
+    });
+    passed &= check(source.reads == 2 && cache.getResidentBytes() == 4 * page,
+                    std::format("prefetch took {} reads for {} bytes", source.reads.load(), cache.getResidentBytes()));
+    // The last two straddle blocks and are stitched together from the resident ones.
+    std::vector<std::pair<uint64_t, SIZE_T>> views{{100, 8}, {2 * page + 16, 8}, {5 * page, 8}, {page - 4, 8},
+                                                   {100, 2 * page}};
+    for (auto [offset, length] : views) {
+        auto view = cache.view(region, offset, length);
+        passed &= check(std::vector<byte>(view.begin(), view.end()) == expected(base + offset, length),
+                        "prefetched block matches the source");
+    }
+    passed &= check(source.reads == 2, "prefetched blocks served without reads");
+    // Hits on blocks the thread still pins never reach the cache, views of other blocks push the pins out.
+    auto unpin = [&cache, &region] {
+        for (SIZE_T i = 0; i < eve::LazyRegionCache::pinsPerThread; i++) {
+            cache.view(region, (8 + i) * page, 8);
+        }
+    };
+    // Two blocks fit. Block 2 is used again before block 3 needs room, so block 1 goes.
+    eve::LazyRegionCache small(source, page, 2 * page);
+    for (uint64_t block : {0, 1, 2, 2, 3}) {
+        small.view(region, block * page, 8);
+        unpin();
+    }
+    source.reads = 0;
+    small.view(region, 2 * page, 8);
+    passed &= check(small.getResidentBytes() == 2 * page && source.reads == 0, "used block survives eviction");
+    small.view(region, page, 8);
+    passed &= check(source.reads == 1, "unused block evicted");
+    return passed;
+}
+
+static bool checkDiscoveryCache()
+{
+    auto passed = true;
+    auto directory = std::filesystem::temp_directory_path() / std::format("sanderling-discovery-{}", getpid());
+    eve::DiscoveryRecord record{
+            42, 1234, 0xF00D, {{"type", {(PVOID)0x1000}}, {"builtin", {(PVOID)0x2000, (PVOID)0x3000}}}};
+    passed &= check(eve::DiscoveryCache::save(directory.string(), record), "discovery record saved");
+    auto loaded = eve::DiscoveryCache::load(directory.string(), 42, 1234);
+    passed &= check(loaded.has_value() && loaded->fingerprint == record.fingerprint
+                    && loaded->addresses == record.addresses,
+                    "discovery record loaded");
+    passed &= check(!eve::DiscoveryCache::load(directory.string(), 42, 1235).has_value(),
+                    "record of another process start ignored");
+    auto path = eve::DiscoveryCache::recordPath(directory.string(), 42, 1234);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+    passed &= check(!eve::DiscoveryCache::load(directory.string(), 42, 1234).has_value(), "truncated record rejected");
+
+    // A reader restores the types from the record the first one saved, without scanning.
+    auto heap = std::make_shared<eve::SyntheticHeap>(eve::SyntheticHeapOptions{.heapBytes = 16ull * 1024 * 1024});
+    for (auto restored : {false, true}) {
+        eve::EVEOnlineReader reader(std::make_unique<eve::SyntheticMemorySource>(heap), 2, nullptr,
+                                    eve::CacheOptions{.discoveryCacheDirectory = directory.string(),
+                                                      .collectStats = true});
+        eve::UITree tree;
+        passed &= check(reader.readUITree(tree) && tree.size() == heap->getUINodeCount(),
+                        "UI tree read after the discovery");
+        passed &= check((reader.getStats()[eve::ReaderStage::typeScan].calls == 0) == restored,
+                        restored ? "python types restored" : "python types scanned");
+    }
+    std::filesystem::remove_all(directory);
+    return passed;
+}
+
+#ifdef __linux__
+static bool checkLinuxSource()
+{
+    auto passed = true;
+    eve::LinuxProcessMemorySource source(getpid());
+    std::vector<byte> bytes(3 * eve::cachePageSize);
+    for (SIZE_T i = 0; i < bytes.size(); i++) {
+        bytes[i] = (byte)(i * 29);
+    }
+    auto address = (uint64_t)bytes.data();
+    passed &= check(source.isOpen() && source.processStartTime() != 0, "own process opened");
+    auto regions = source.enumerateReadableRegions();
+    passed &= check(std::ranges::any_of(regions, [address](auto& region) {
+        return (uint64_t)region.baseAddress <= address && address < (uint64_t)region.baseAddress + region.regionSize;
+    }), "heap found in /proc/self/maps");
+    std::vector<byte> copy(bytes.size());
+    passed &= check(source.read(bytes.data(), copy.data(), copy.size()) == bytes.size() && copy == bytes,
+                    "process_vm_readv of the own heap");
+    // The unmapped request in the middle ends the syscall, the batch goes on after it.
+    std::array<uint64_t, 3> words{};
+    std::array<eve::MemoryReadRequest, 3> requests{{{bytes.data(), &words[0], 8},
+                                                    {(PVOID)0x10, &words[1], 8},
+                                                    {bytes.data() + 8, &words[2], 8}}};
+    source.readBatch(requests);
+    passed &= check(requests[0].bytesRead == 8 && requests[1].bytesRead == 0 && requests[2].bytesRead == 8
+                    && std::memcmp(&words[2], bytes.data() + 8, 8) == 0,
+                    "batch read around an unmapped request");
+    return passed;
+}
+#endif
+
+static bool checkScanKernels()
+{
+    auto passed = true;
+    const uint64_t base = 0x7F0000001000;
+    std::vector<uint64_t> words(1024 + 1);
+    std::mt19937_64 random(5);
+    for (SIZE_T i = 0; i < words.size(); i++) {
+        words[i] = random();
+    }
+    for (SIZE_T i = 0; i + 1 < words.size(); i += 1 + random() % 13) {
+        auto self = base + 8 * i;
+        // Some planted words only match in one 32 bit half, which the SSE2 kernel must not take.
+        words[i + 1] = i % 3 == 0 ? self ^ (1ull << 40) : i % 3 == 1 ? self ^ 8 : self;
+    }
+    std::vector<std::pair<const char*, eve::kernels::SelfReferenceScan>> kernels{
+            {"scalar", eve::kernels::findSelfReferencesScalar}};
+#ifdef SANDERLING_X86_64
+    kernels.emplace_back("sse2", eve::kernels::findSelfReferencesSSE2);
+    if (eve::kernels::cpuSupportsAVX2()) {
+        kernels.emplace_back("avx2", eve::kernels::findSelfReferencesAVX2);
+    }
+#endif
+    // Every begin and end around the vector widths, for the heads and tails the scalar loop finishes.
+    std::vector<SIZE_T> expected, hits;
+    for (SIZE_T begin = 0; begin < 9; begin++) {
+        for (SIZE_T end = words.size() - 18; end < words.size(); end++) {
+            expected.clear();
+            eve::kernels::findSelfReferencesScalar(words.data(), begin, end, base, expected);
+            for (auto [name, kernel] : kernels) {
+                hits.clear();
+                kernel(words.data(), begin, end, base, hits);
+                passed &= check(hits == expected && !expected.empty(),
+                                std::format("{} kernel over [{}, {})", name, begin, end));
+            }
+        }
+    }
+    return passed;
+}
+
+static bool checkSharedFrameRing(const eve::UITree& tree)
+{
+    auto passed = true;
+    auto slotBytes = 2 * (tree.size() * 128 + tree.stringPool.size());
+    auto segment = eve::SharedMemorySegment::local(eve::SharedFramePublisher::requiredBytes(3, slotBytes));
+    eve::SharedFramePublisher publisher(segment, 3);
+    eve::SharedFrameSubscriber subscriber(segment);
+    passed &= check(subscriber.isValid() && !subscriber.acquire().has_value(), "empty frame ring");
+    passed &= check(publisher.publish(tree, std::chrono::steady_clock::now()), "frame published");
+    eve::UITree copy;
+    passed &= check(subscriber.copyLatest(copy) == 1 && copy.size() == tree.size()
+                    && copy.address == tree.address && copy.typeNames == tree.typeNames
+                    && copy.string(copy.text.back()) == tree.string(tree.text.back()),
+                    "frame copied from the ring");
+    auto frame = subscriber.acquire();
+    passed &= check(frame.has_value() && frame->size() == tree.size() && subscriber.validate(*frame),
+                    "frame read in place");
+    for (int i = 0; i < 3; i++) {
+        publisher.publish(tree, std::chrono::steady_clock::now());
+    }
+    passed &= check(frame.has_value() && !subscriber.validate(*frame), "overwritten frame detected");
+
+    auto name = std::format("/sanderling-test-{}", getpid());
+    auto shared = eve::SharedMemorySegment::create(name, eve::SharedFramePublisher::requiredBytes(2, slotBytes));
+    if (shared != nullptr) {
+        eve::SharedFramePublisher sharedPublisher(shared, 2);
+        sharedPublisher.publish(tree, std::chrono::steady_clock::now());
+        eve::SharedFrameSubscriber sharedSubscriber(eve::SharedMemorySegment::open(name));
+        passed &= check(sharedSubscriber.copyLatest(copy) == 1 && copy.size() == tree.size(),
+                        "frame read through shm");
+    }
+    return passed;
+}
+
+static bool checkSyntheticHeap()
+{
+    auto heap = std::make_shared<eve::SyntheticHeap>(eve::SyntheticHeapOptions{.heapBytes = 64ull * 1024 * 1024});
+    auto passed = true;
+    for (auto lazy : {false, true}) {
+        eve::EVEOnlineReader reader(std::make_unique<eve::SyntheticMemorySource>(heap), 4, nullptr,
+                                    eve::CacheOptions{.lazy = lazy, .collectStats = true});
+        passed &= check(reader.isBuiltinType(heap->getBuiltinType("dict"), "dict"), "builtin types discovered");
+        passed &= check(reader.getPyObjectTypeName(heap->getUIRoot()) == "UIRoot", "UIRoot discovered");
+        eve::UITree tree;
+        passed &= check(reader.readUITree(tree), "UI tree read");
+        passed &= check(tree.size() == heap->getUINodeCount(),
+                        std::format("{} UI nodes read, {} expected", tree.size(), heap->getUINodeCount()));
+        passed &= check(!tree.empty() && tree.address[0] == heap->getUIRoot(), "UIRoot is the first row");
+        eve::UITreeDelta delta;
+        reader.readUITreeDelta(delta);
+        reader.readUITreeDelta(delta);
+        passed &= check(delta.empty(), "unchanged heap gives an empty delta");
+        auto stats = reader.getStats();
+        passed &= check(stats[eve::ReaderStage::typeScan][eve::StageCounter::candidatesAccepted] > 0,
+                        "type scan candidates counted");
+        passed &= check(stats[eve::ReaderStage::uiTree].calls == 3
+                        && stats[eve::ReaderStage::uiTree][eve::StageCounter::candidatesAccepted]
+                               == 3 * heap->getUINodeCount(),
+                        "UI tree reads counted");
+        passed &= check(!lazy || stats[eve::ReaderStage::typeScan][eve::StageCounter::bytesRead] > 0,
+                        "lazy reads counted");
+
+        SIZE_T colors = 0, texts = 0;
+        eve::PyValue value;
+        eve::PyValueBuffer buffer;
+        for (auto address : heap->getStrings()) {
+            passed &= check(reader.decodePythonValue(address, value, buffer) && value.kind == eve::PyValueKind::string,
+                            "str decoded");
+        }
+        for (SIZE_T row = 0; row < tree.size(); row++) {
+            texts += tree.string(tree.text[row]).ends_with("\u00e9\u2713\U0001F680");
+        }
+        std::vector<eve::DictEntry> entries;
+        for (auto address : tree.address) {
+            auto dict = reader.readCachedValue<PVOID>((LPBYTE)address + 0x10);
+            entries.clear();
+            reader.readDictEntriesOfInterest(*dict, entries);
+            for (auto& [keyId, entryValue] : entries) {
+                if (reader.getDictEntryOfInterestKey(keyId) == "_color"
+                    && reader.decodePythonValue(entryValue, value, buffer)) {
+                    colors += value.kind == eve::PyValueKind::color && value.rgba[1] == 0.5f;
+                }
+            }
+        }
+        passed &= check(texts > 0, "unicode texts decoded to UTF-8");
+        passed &= check(colors > 0, "PyColor decoded");
+        if (!lazy) {
+            passed &= checkSharedFrameRing(tree);
+        }
+
+        eve::UITreePoller poller(reader, eve::PollerOptions{.interval = std::chrono::milliseconds(5)});
+        passed &= check(poller.acquire() == nullptr, "no frame before the first poll");
+        poller.start();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (poller.getStats().framesPublished < 3 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto frame = poller.acquire();
+        passed &= check(frame != nullptr && frame->tree.size() == heap->getUINodeCount(), "poller frame acquired");
+        passed &= check(frame != nullptr && frame->delta.empty(), "unchanged heap gives empty frame deltas");
+        poller.stop();
+        auto pollerStats = poller.getStats();
+        passed &= check(pollerStats.framesDropped > 0 && pollerStats.framesAcquired == 1, "dropped frames counted");
+    }
+    LOG_S(INFO) << (passed ? "synthetic heap checks passed." : "synthetic heap checks failed.");
+    return passed;
+}
+
+static bool checkUITreeDelta()
+{
+    auto passed = true;
+    for (auto lazy : {false, true}) {
+        auto heap = std::make_shared<eve::SyntheticHeap>(eve::SyntheticHeapOptions{.heapBytes = 16ull * 1024 * 1024});
+        eve::EVEOnlineReader reader(std::make_unique<eve::SyntheticMemorySource>(heap), 4, nullptr,
+                                    eve::CacheOptions{.lazy = lazy});
+        eve::UITreeDelta delta;
+        auto& baseline = reader.readUITreeDelta(delta);
+        // The last parent above leaves, so every change below hits a leaf.
+        auto parent = heap->getUIRoot();
+        while (!heap->getChildren(heap->getChildren(parent)[0]).empty()) {
+            parent = heap->getChildren(parent)[0];
+        }
+        auto leaves = heap->getChildren(parent);
+        auto removed = leaves[0], moved = leaves[1], renamed = leaves[2], reused = leaves[3];
+        heap->removeChild(parent, removed);
+        heap->moveNode(moved, 5000, 5000);
+        heap->renameNode(renamed, "renamed");
+        // New values at the addresses of the old ones, the dict slots stay the same.
+        auto reusedRow = std::ranges::find(baseline.address, reused) - baseline.address.begin();
+        auto reusedName = std::string(baseline.string(baseline.name[reusedRow]));
+        std::ranges::reverse(reusedName);
+        heap->resizeNodeInPlace(reused, 4321);
+        heap->renameNodeInPlace(reused, reusedName);
+        auto added = heap->addChild(parent);
+        reader.refreshObjectRegions();
+        auto& tree = reader.readUITreeDelta(delta);
+        passed &= check(tree.size() == heap->getUINodeCount(), "changed tree read");
+        passed &= check(delta.added.size() == 1 && tree.address[delta.added[0]] == added, "added node in the delta");
+        passed &= check(delta.removed == std::vector<PVOID>{removed}, "removed node in the delta");
+        std::map<PVOID, uint32_t> changed;
+        for (SIZE_T i = 0; i < delta.changed.size(); i++) {
+            changed[tree.address[delta.changed[i]]] = delta.changedProperties[i];
+        }
+        passed &= check(changed == std::map<PVOID, uint32_t>{{moved, eve::uiDisplayX | eve::uiDisplayY},
+                                                              {renamed, eve::uiName},
+                                                              {reused, eve::uiDisplayWidth | eve::uiName}},
+                        std::format("{} changed nodes in the delta, 3 expected", changed.size()));
+        passed &= check(delta.reusedNodes > 0, "unchanged nodes reused");
+    }
+    return passed;
+}
+
+static bool checkReaderService()
+{
+    auto heap = std::make_shared<eve::SyntheticHeap>(eve::SyntheticHeapOptions{.heapBytes = 16ull * 1024 * 1024});
+    auto passed = true;
+    eve::ReaderService service(eve::ServiceOptions{.memoryBudget = 64ull * 1024 * 1024});
+    std::vector<eve::SPSC> clients;
+    for (uint32_t priority : {0, 1, 0}) {
+        clients.push_back(service.attach(std::make_unique<eve::SyntheticMemorySource>(heap),
+                                         eve::ClientOptions{.priority = priority,
+                                                            .interval = std::chrono::milliseconds(5)}));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    auto allPublished = [&clients] {
+        return std::ranges::all_of(clients, [](auto& client) { return client->getStats().framesPublished >= 2; });
+    };
+    while (!allPublished() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    SIZE_T residentBytes = 0;
+    for (auto& client : clients) {
+        auto frame = client->acquire();
+        passed &= check(frame != nullptr && frame->tree.size() == heap->getUINodeCount(), "service frame acquired");
+        residentBytes += client->getStats().residentBytes;
+    }
+    passed &= check(residentBytes <= 64ull * 1024 * 1024, "service memory budget kept");
+    passed &= check(clients[1]->getStats().byteBudget == 2 * clients[0]->getStats().byteBudget,
+                    "memory budget split by priority");
+    service.detach(clients[1]);
+    passed &= check(service.clientCount() == 2 && clients[0]->getStats().byteBudget == 32ull * 1024 * 1024,
+                    "memory budget rebalanced on detach");
+    LOG_S(INFO) << (passed ? "reader service checks passed." : "reader service checks failed.");
+    return passed;
+}
+
+static bool checkReaderServiceFailures()
+{
+    auto heap = std::make_shared<eve::SyntheticHeap>(eve::SyntheticHeapOptions{.heapBytes = 16ull * 1024 * 1024});
+    auto passed = true;
+    eve::ReaderService service(eve::ServiceOptions{.memoryBudget = 64ull * 1024 * 1024});
+    auto closedSource = std::make_unique<BufferMemorySource>(0x10000, std::vector<byte>(64 * 1024));
+    closedSource->open = false;
+    auto closed = service.attach(std::move(closedSource));
+    passed &= check(closed->getStats().failed && service.clientCount() == 0, "closed source not queued");
+    // No python types in a page of zeros, the discovery fails.
+    auto broken = service.attach(std::make_unique<BufferMemorySource>(0x10000, std::vector<byte>(64 * 1024)),
+                                 eve::ClientOptions{.interval = std::chrono::milliseconds(5)});
+    auto healthy = service.attach(std::make_unique<eve::SyntheticMemorySource>(heap),
+                                  eve::ClientOptions{.interval = std::chrono::milliseconds(5)});
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while ((!broken->isFailed() || healthy->getStats().framesPublished < 2) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    auto stats = broken->getStats();
+    passed &= check(stats.failed && !stats.attached && !stats.error.empty(), "failed discovery reported");
+    passed &= check(healthy->getStats().framesPublished >= 2 && !healthy->isFailed(),
+                    "healthy client read next to a failed one");
+    service.detach(broken);
+    passed &= check(service.clientCount() == 1 && healthy->getStats().byteBudget == 64ull * 1024 * 1024,
+                    "failed client dropped from the budget");
+    service.detach(healthy);
+    LOG_S(INFO) << (passed ? "reader service failure checks passed." : "reader service failure checks failed.");
+    return passed;
+}
+
 int main(int argc, char* argv[])
 {
     loguru::g_preamble_header = false;
@@ -11,7 +566,25 @@ int main(int argc, char* argv[])
     loguru::g_stderr_verbosity = Verbosity_INFO;
     loguru::g_colorlogtostderr = false;
     loguru::init(argc, argv);
-    DWORD processId = 29020;
+    // Without a process id, the readers run against a synthetic heap and the results are checked.
+    DWORD processId = argc > 1 ? std::stoul(argv[1]) : 0;
+    if (processId == 0) {
+        auto passed = checkWorkerPool();
+        passed &= checkLazyCacheReuse();
+        passed &= checkPageChanges();
+        passed &= checkSnapshotRoundTrip();
+        passed &= checkReadPlanner();
+        passed &= checkDiscoveryCache();
+        passed &= checkScanKernels();
+#ifdef __linux__
+        passed &= checkLinuxSource();
+#endif
+        passed &= checkSyntheticHeap();
+        passed &= checkUITreeDelta();
+        passed &= checkReaderService();
+        passed &= checkReaderServiceFailures();
+        return passed ? 0 : 1;
+    }
     std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
     auto reader = new eve::EVEOnlineReader(processId, 16);
 //    auto uiRootTypes = reader->EnumerateCandidatesForPythonUIRoot();
@@ -0,0 +1,148 @@
+//
+// Created by allan on 2024/4/20.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace eve {
+
+    /**
+     * Addresses found by the discovery scans of one process, by what they are ("type", "builtin", "UIRoot", ...).
+     * `fingerprint` identifies the loaded build, see PythonMemoryReader::discoveryFingerprint().
+     */
+    struct DiscoveryRecord {
+        DWORD processId = 0;
+        uint64_t processStartTime = 0;
+        uint64_t fingerprint = 0;
+        std::map<std::string, std::vector<PVOID>> addresses;
+
+        [[nodiscard]] inline const std::vector<PVOID> *find(const std::string &key) const {
+            auto entry = addresses.find(key);
+            return entry == addresses.end() ? nullptr : &entry->second;
+        }
+    };
+
+    /**
+     * Discovery records on disk, one file per process in a directory:
+     *
+     *   DiscoveryHeader
+     *   DiscoveryEntryHeader, key, uint64_t[addressCount]      entryCount times
+     *
+     * The file name holds the process id and start time, so a record is never picked up by another process that
+     * got the same id. Files are replaced through a rename, readers never see a partially written record.
+     */
+    static constexpr char discoveryMagic[8] = {'S', 'D', 'L', 'D', 'I', 'S', 'C', '\0'};
+    static constexpr uint32_t discoveryVersion = 1;
+
+    struct DiscoveryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t processId;
+        uint64_t processStartTime;
+        uint64_t fingerprint;
+        uint64_t entryCount;
+    };
+
+    struct DiscoveryEntryHeader {
+        uint32_t keyLength;
+        uint32_t addressCount;
+    };
+
+    class DiscoveryCache {
+    public:
+        static inline std::string recordPath(const std::string &directory, DWORD processId, uint64_t processStartTime) {
+            return (std::filesystem::path(directory) / std::format("{}-{}.discovery", processId, processStartTime))
+                    .string();
+        }
+
+        /**
+         * The record of the given process, nullopt if there is none or it cannot be used.
+         */
+        static inline std::optional<DiscoveryRecord> load(const std::string &directory, DWORD processId,
+                                                          uint64_t processStartTime) {
+            auto path = recordPath(directory, processId, processStartTime);
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return std::nullopt;
+            }
+            DiscoveryHeader header{};
+            if (!file.read((char *) &header, sizeof(header)) ||
+                std::memcmp(header.magic, discoveryMagic, sizeof(discoveryMagic)) != 0 ||
+                header.version != discoveryVersion || header.processId != processId ||
+                header.processStartTime != processStartTime) {
+                LOG_S(WARNING) << std::format("Ignoring invalid discovery cache {}.", path);
+                return std::nullopt;
+            }
+            DiscoveryRecord record{header.processId, header.processStartTime, header.fingerprint, {}};
+            for (uint64_t i = 0; i < header.entryCount; i++) {
+                DiscoveryEntryHeader entry{};
+                if (!file.read((char *) &entry, sizeof(entry)) || maxKeyLength < entry.keyLength ||
+                    maxAddressCount < entry.addressCount) {
+                    LOG_S(WARNING) << std::format("Ignoring truncated discovery cache {}.", path);
+                    return std::nullopt;
+                }
+                std::string key(entry.keyLength, '\0');
+                std::vector<PVOID> addresses(entry.addressCount);
+                file.read(key.data(), entry.keyLength);
+                file.read((char *) addresses.data(), (std::streamsize) (entry.addressCount * sizeof(PVOID)));
+                if (!file) {
+                    LOG_S(WARNING) << std::format("Ignoring truncated discovery cache {}.", path);
+                    return std::nullopt;
+                }
+                record.addresses[key] = std::move(addresses);
+            }
+            return record;
+        }
+
+        static inline bool save(const std::string &directory, const DiscoveryRecord &record) {
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+            auto path = recordPath(directory, record.processId, record.processStartTime);
+            auto temporaryPath = std::format("{}.{:08x}.tmp", path, std::random_device{}());
+            {
+                std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+                if (!file) {
+                    LOG_S(WARNING) << std::format("Failed to create discovery cache {}.", temporaryPath);
+                    return false;
+                }
+                DiscoveryHeader header{};
+                std::memcpy(header.magic, discoveryMagic, sizeof(header.magic));
+                header.version = discoveryVersion;
+                header.processId = record.processId;
+                header.processStartTime = record.processStartTime;
+                header.fingerprint = record.fingerprint;
+                header.entryCount = record.addresses.size();
+                file.write((const char *) &header, sizeof(header));
+                for (auto &[key, addresses]: record.addresses) {
+                    DiscoveryEntryHeader entry{(uint32_t) key.size(), (uint32_t) addresses.size()};
+                    file.write((const char *) &entry, sizeof(entry));
+                    file.write(key.data(), (std::streamsize) key.size());
+                    file.write((const char *) addresses.data(), (std::streamsize) (addresses.size() * sizeof(PVOID)));
+                }
+                file.flush();
+                if (!file) {
+                    LOG_S(WARNING) << std::format("Failed to write discovery cache {}.", temporaryPath);
+                    std::filesystem::remove(temporaryPath, error);
+                    return false;
+                }
+            }
+            std::filesystem::rename(temporaryPath, path, error);
+            if (error) {
+                LOG_S(WARNING) << std::format("Failed to replace discovery cache {}: {}.", path, error.message());
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t maxKeyLength = 255;
+        static constexpr uint32_t maxAddressCount = 4096;
+    };
+}
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "PythonMemoryReader.h"
+#include "UITree.h"
 
 namespace eve {
 
@@ -14,36 +15,125 @@ namespace eve {
 
     class EVEOnlineReader : public PythonMemoryReader {
     public:
-        explicit EVEOnlineReader(DWORD processId, uint8_t numThreads = 4) : PythonMemoryReader(processId, numThreads) {
-            EnumerateCandidatesForPythonUIRoot();
+        explicit EVEOnlineReader(DWORD processId, uint8_t numThreads = 4) : EVEOnlineReader(
+                openProcessMemorySource(processId), numThreads) {}
+
+        explicit EVEOnlineReader(PMS source, uint8_t numThreads = 4, SPWP workerPool = nullptr,
+                                 CacheOptions cacheOptions = {}) :
+                PythonMemoryReader(std::move(source), numThreads, std::move(workerPool), cacheOptions) {
+            registerValueDecoder("PyColor"sv, decodePyColor);
+            registerValueDecoder("Bunch"sv, decodeBunch);
+            auto restoredUIRootType = restoreUIRootType();
+            if (!restoredUIRootType) {
+                EnumerateCandidatesForPythonUIRoot();
+            }
             if (pythonUIRootTypes != nullptr && pythonUIRootTypes->size() == 1) {
                 eveTypesMapping[*pythonUIRootTypes->begin()] = "UIRoot";
                 setEVEObjectRegions(*pythonUIRootTypes->begin());
                 LOG_S(INFO) << std::format("eve UIRoot type found @ 0x{:X}", (uint64_t) *pythonUIRootTypes->begin());
             }
-            EnumerateCandidatesForPythonUIRootObject();
+            if (restoredUIRootType && restoreUIRootObjects()) {
+                LOG_S(INFO) << "UIRoot restored from the discovery cache.";
+            } else {
+                EnumerateCandidatesForPythonUIRootObject();
+                discovery.addresses["UIRoot"] = std::vector<PVOID>(pythonUIRootTypes->begin(),
+                                                                   pythonUIRootTypes->end());
+                discovery.addresses["UIRootObject"] = std::vector<PVOID>(pythonUIRootObjects->begin(),
+                                                                         pythonUIRootObjects->end());
+            }
+            saveDiscovery();
+        }
+
+
+        /**
+         * PythonMemoryReader::refreshCache(), and re-filters the eve object regions when the region layout changed.
+         */
+        inline CacheDiff refreshCache(CPMMR regionsToReread = nullptr) {
+            auto diff = PythonMemoryReader::refreshCache(regionsToReread);
+            if (diff.hasLayoutChanges()) {
+                dictKeyIds.clear();
+                childrenListKeyIds.clear();
+                colorKeyIds.clear();
+            }
+            if (diff.hasLayoutChanges() && !eveTypesMapping.empty()) {
+                eveObjectRegions = nullptr;
+                setEVEObjectRegions(eveTypesMapping.begin()->first);
+            }
+            return diff;
+        }
+
+        /**
+         * Entries of the dict at `dictObjectAddress` with a key in DictEntriesOfInterestKeys, appended to `entries`.
+         * Key ids index DictEntriesOfInterestKeys, see getDictEntryOfInterestKey().
+         */
+        inline bool readDictEntriesOfInterest(PVOID dictObjectAddress, std::vector<DictEntry> &entries) {
+            return readPythonDict(dictObjectAddress, DictEntriesOfInterestKeys, dictKeyIds, entries);
+        }
+
+        static constexpr std::string_view getDictEntryOfInterestKey(uint32_t keyId) {
+            return DictEntriesOfInterestKeys[keyId];
+        }
+
+        /**
+         * Walks the UI tree down from the UIRoot objects into `tree`, one depth level at a time. The nodes of a
+         * level are decoded in parallel batches, then appended in order, so the result does not depend on the
+         * thread count. A node reached twice (only possible in garbage memory) is kept once.
+         *
+         * Returns false if no UIRoot object is known.
+         */
+        inline bool readUITree(UITree &tree, SIZE_T maxDepth = 64, SIZE_T maxNodes = 1 << 16) {
+            UITreeFrame frame;
+            frame.tree = std::move(tree);
+            auto found = readUITreeFrame(frame, nullptr, maxDepth, maxNodes);
+            tree = std::move(frame.tree);
+            return found;
         }
 
+        /**
+         * Delta mode of readUITree(), meant to be called once per frame after refreshObjectRegions(). Nodes whose
+         * object, dict and children list are byte for byte the same as in the previous call are taken over instead
+         * of decoded again, and `delta` tells what was added, removed or changed since. Nodes are matched by
+         * address and type object.
+         *
+         * The returned tree stays valid until the next call.
+         */
+        inline const UITree &readUITreeDelta(UITreeDelta &delta, SIZE_T maxDepth = 64, SIZE_T maxNodes = 1 << 16) {
+            std::swap(previousUIFrame, currentUIFrame);
+            readUITreeFrame(currentUIFrame, &previousUIFrame, maxDepth, maxNodes);
+            diffUITreeFrames(previousUIFrame, currentUIFrame, delta);
+            return currentUIFrame.tree;
+        }
+
+        /**
+         * Per-frame refresh: only the regions holding eve objects are fetched again.
+         */
+        inline CacheDiff refreshObjectRegions() {
+            if (eveObjectRegions == nullptr) {
+                return refreshCache();
+            }
+            return refreshCache(eveObjectRegions);
+        }
 
         inline void EnumerateCandidatesForPythonUIRoot() {
-            pythonUIRootTypes = std::move(EnumerateCandidatesForPythonObjects(
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::uiRootTypeScan);
+            auto candidatesByName = EnumerateCandidatesForPythonObjectsByTypeName(
                     [this](uint64_t *ob_type) {
                         return pythonTypes->contains(ob_type);
                     },
-                    [](PSTR const &tp_name) {
-                        return tp_name != nullptr and *tp_name == "UIRoot";
-                    },
+                    eveTypeNames,
                     eveObjectRegions
-            ));
+            );
+            pythonUIRootTypes = make_unique<USP>(std::move(candidatesByName[eveTypeNames.find("UIRoot")]));
             LOG_S(INFO) << std::format("{} python UIRoot Types found.", pythonUIRootTypes->size());
         }
 
         inline void EnumerateCandidatesForPythonUIRootObject() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::uiRootObjectScan);
             pythonUIRootObjects = std::move(EnumerateCandidatesForPythonObjects(
                     [this](uint64_t *ob_type) {
                         return pythonUIRootTypes->contains(ob_type);
                     },
-                    [](PSTR const &tp_name) {
+                    [](std::string_view tp_name) {
                         return true;
                     },
                     eveObjectRegions
@@ -56,45 +146,475 @@ namespace eve {
 
 
     private:
+        // The instance dict pointer of UI objects.
+        static constexpr SIZE_T uiNodeDictOffset = 0x10;
+        static constexpr SIZE_T uiNodesPerBatch = 32;
+        static constexpr SIZE_T maxUITextLength = 4096;
+
+        struct UINodeRef {
+            PVOID address;
+            uint32_t parentRow;
+        };
+
+        // Number of scalar properties decodeUINodes() reads, the sizes, name and texts.
+        static constexpr SIZE_T uiNodeValues = 8;
+
+        /**
+         * The objects a node was decoded from besides itself, and a hash over all of them. The hash covers the
+         * payloads of the property values too, as CPython reuses the addresses of freed numbers and strings.
+         */
+        struct UINodeFootprint {
+            PVOID dict = nullptr;
+            PVOID childrenDict = nullptr;
+            PVOID childrenList = nullptr;
+            std::array<PVOID, uiNodeValues> values = {};
+            uint64_t hash = 0;
+        };
+
+        /**
+         * A read tree plus what the delta mode needs to take nodes over: the type object, footprint and raw
+         * children of every row (children of row i in children[childrenEnd[i - 1], childrenEnd[i])).
+         */
+        struct UITreeFrame {
+            UITree tree;
+            std::vector<PVOID> typeObjects;
+            std::vector<UINodeFootprint> footprints;
+            std::vector<PVOID> children;
+            std::vector<uint32_t> childrenEnd;
+            std::unordered_map<PVOID, uint32_t> rows;
+            SIZE_T decodedNodes = 0;
+            SIZE_T reusedNodes = 0;
+
+            inline void clear() {
+                tree.clear();
+                typeObjects.clear();
+                footprints.clear();
+                children.clear();
+                childrenEnd.clear();
+                rows.clear();
+                decodedNodes = 0;
+                reusedNodes = 0;
+            }
+        };
+
+        /**
+         * Decoded nodes of one batch, laid out like a UITreeFrame with its own string pool and without type ids.
+         */
+        struct UINodeBatch {
+            UITreeFrame nodes;
+            std::vector<DictEntry> entries;
+        };
+
+        inline bool readUITreeFrame(UITreeFrame &frame, const UITreeFrame *previous, SIZE_T maxDepth,
+                                    SIZE_T maxNodes) {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::uiTree);
+            frame.clear();
+            if (pythonUIRootObjects == nullptr || pythonUIRootObjects->empty()) {
+                return false;
+            }
+            // Candidates are the addresses the walk reached, accepted the ones that decoded into a row.
+            SIZE_T visitedNodes = 0;
+            auto &tree = frame.tree;
+            std::unordered_set<PVOID> visited;
+            std::unordered_map<PVOID, uint32_t> typeIds;
+            std::vector<UINodeRef> level, nextLevel;
+            for (auto rootAddress: *pythonUIRootObjects) {
+                level.push_back({rootAddress, UITree::noParent});
+                visited.insert(rootAddress);
+            }
+            std::vector<UINodeBatch> batches;
+            for (SIZE_T depth = 0; depth <= maxDepth && !level.empty(); depth++) {
+                visitedNodes += level.size();
+                prefetchUINodes(level);
+                batches.resize((level.size() + uiNodesPerBatch - 1) / uiNodesPerBatch);
+                workerPool->parallelFor(batches.size(), [&](SIZE_T i) {
+                    auto begin = i * uiNodesPerBatch;
+                    auto nodes = std::span(level).subspan(begin, std::min(uiNodesPerBatch, level.size() - begin));
+                    decodeUINodes(nodes, previous, batches[i]);
+                });
+                auto levelBegin = tree.size();
+                for (auto &batch: batches) {
+                    appendUINodes(batch.nodes, (uint16_t) depth, frame, typeIds);
+                }
+                nextLevel.clear();
+                for (auto row = levelBegin; row < tree.size(); row++) {
+                    auto childrenBegin = row == 0 ? 0 : frame.childrenEnd[row - 1];
+                    for (auto child = childrenBegin; child < frame.childrenEnd[row]; child++) {
+                        auto childAddress = frame.children[child];
+                        if (tree.size() + nextLevel.size() >= maxNodes || !visited.insert(childAddress).second) {
+                            continue;
+                        }
+                        nextLevel.push_back({childAddress, (uint32_t) row});
+                    }
+                }
+                std::swap(level, nextLevel);
+            }
+            instrumentation.add(StageCounter::candidatesTested, visitedNodes);
+            instrumentation.add(StageCounter::candidatesAccepted, tree.size());
+            return true;
+        }
+
+        /**
+         * Lazy mode: fetches what decodeUINodes() reads first of a level, the node objects, their dicts and the
+         * slot tables, in three planned reads instead of one read per missing block.
+         */
+        inline void prefetchUINodes(std::span<const UINodeRef> refs) {
+            if (lazyCache == nullptr) {
+                return;
+            }
+            std::vector<PageRange> nodes, dicts, slotTables;
+            for (auto &ref: refs) {
+                nodes.push_back({ref.address, uiNodeDictOffset + sizeof(PVOID)});
+            }
+            prefetchCached(nodes);
+            for (auto &ref: refs) {
+                auto dictAddress = readCachedValue<PVOID>((LPBYTE) ref.address + uiNodeDictOffset);
+                if (dictAddress.has_value()) {
+                    dicts.push_back({*dictAddress, sizeof(py27::PyDictObject)});
+                }
+            }
+            prefetchCached(dicts);
+            for (auto &dict: dicts) {
+                auto dictObject = readCachedValue<py27::PyDictObject>(dict.address);
+                if (dictObject.has_value() && dictObject->ma_mask < maxDictSlots) {
+                    slotTables.push_back({dictObject->ma_table, (dictObject->ma_mask + 1) * sizeof(py27::PyDictEntry)});
+                }
+            }
+            prefetchCached(slotTables);
+        }
+
+        inline void decodeUINodes(std::span<const UINodeRef> refs, const UITreeFrame *previous, UINodeBatch &batch) {
+            static constexpr auto displayXKey = DictEntriesOfInterestKeys.find("_displayX"sv);
+            static constexpr auto displayYKey = DictEntriesOfInterestKeys.find("_displayY"sv);
+            static constexpr auto displayWidthKey = DictEntriesOfInterestKeys.find("_displayWidth"sv);
+            static constexpr auto displayHeightKey = DictEntriesOfInterestKeys.find("_displayHeight"sv);
+            static constexpr auto nameKey = DictEntriesOfInterestKeys.find("_name"sv);
+            static constexpr auto textKey = DictEntriesOfInterestKeys.find("_text"sv);
+            static constexpr auto setTextKey = DictEntriesOfInterestKeys.find("_setText"sv);
+            static constexpr auto hintKey = DictEntriesOfInterestKeys.find("_hint"sv);
+            static constexpr auto childrenKey = DictEntriesOfInterestKeys.find("children"sv);
+            const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+            auto &frame = batch.nodes;
+            auto &nodes = frame.tree;
+            frame.clear();
+            auto appendString = [&nodes](StringRef &ref, std::string_view chars) {
+                ref = {(uint32_t) nodes.stringPool.size(), (uint32_t) chars.size()};
+                nodes.stringPool.append(chars);
+            };
+            for (auto &ref: refs) {
+                auto object = readCachedValue<py27::PyObject>(ref.address);
+                auto dictAddress = readCachedValue<PVOID>((LPBYTE) ref.address + uiNodeDictOffset);
+                if (!object.has_value() || !dictAddress.has_value()) {
+                    continue;
+                }
+                if (previous != nullptr && takeOverUINode(ref, object->ob_type, *dictAddress, *previous, frame)) {
+                    continue;
+                }
+                batch.entries.clear();
+                if (!readDictEntriesOfInterest(*dictAddress, batch.entries)) {
+                    continue;
+                }
+                double x = nan, y = nan, width = nan, height = nan;
+                StringRef name, text, setText, hint;
+                UINodeFootprint footprint{*dictAddress};
+                for (auto &[keyId, value]: batch.entries) {
+                    switch ((int) keyId) {
+                        case displayXKey:
+                            footprint.values[0] = value;
+                            x = readPythonNumber(value).value_or(nan);
+                            break;
+                        case displayYKey:
+                            footprint.values[1] = value;
+                            y = readPythonNumber(value).value_or(nan);
+                            break;
+                        case displayWidthKey:
+                            footprint.values[2] = value;
+                            width = readPythonNumber(value).value_or(nan);
+                            break;
+                        case displayHeightKey:
+                            footprint.values[3] = value;
+                            height = readPythonNumber(value).value_or(nan);
+                            break;
+                        case nameKey:
+                            footprint.values[4] = value;
+                            appendString(name, readPythonTextView(value, maxUITextLength));
+                            break;
+                        case textKey:
+                            footprint.values[5] = value;
+                            appendString(text, readPythonTextView(value, maxUITextLength));
+                            break;
+                        case setTextKey:
+                            footprint.values[6] = value;
+                            appendString(setText, readPythonTextView(value, maxUITextLength));
+                            break;
+                        case hintKey:
+                            footprint.values[7] = value;
+                            appendString(hint, readPythonTextView(value, maxUITextLength));
+                            break;
+                        case childrenKey:
+                            readUIChildren(value, footprint, frame.children);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                footprint.hash = hashUINodeFootprint(footprint);
+                nodes.address.push_back(ref.address);
+                nodes.parent.push_back(ref.parentRow);
+                nodes.displayX.push_back(x);
+                nodes.displayY.push_back(y);
+                nodes.displayWidth.push_back(width);
+                nodes.displayHeight.push_back(height);
+                nodes.name.push_back(name);
+                nodes.text.push_back(setText.length != 0 ? setText : text);
+                nodes.hint.push_back(hint);
+                frame.typeObjects.push_back(object->ob_type);
+                frame.footprints.push_back(footprint);
+                frame.childrenEnd.push_back((uint32_t) frame.children.size());
+                frame.decodedNodes += 1;
+            }
+        }
+
+        /**
+         * Copies the node at `ref` from `previous` into `frame` if none of the objects it was decoded from changed.
+         */
+        inline bool takeOverUINode(const UINodeRef &ref, PVOID typeObject, PVOID dictAddress,
+                                   const UITreeFrame &previous, UITreeFrame &frame) const {
+            auto previousRow = previous.rows.find(ref.address);
+            if (previousRow == previous.rows.end()) {
+                return false;
+            }
+            auto row = previousRow->second;
+            auto &footprint = previous.footprints[row];
+            if (previous.typeObjects[row] != typeObject || footprint.dict != dictAddress ||
+                hashUINodeFootprint(footprint) != footprint.hash) {
+                return false;
+            }
+            auto &from = previous.tree;
+            auto &nodes = frame.tree;
+            auto copyString = [&](StringRef ref) {
+                auto copy = StringRef{(uint32_t) nodes.stringPool.size(), ref.length};
+                nodes.stringPool.append(from.string(ref));
+                return copy;
+            };
+            nodes.address.push_back(ref.address);
+            nodes.parent.push_back(ref.parentRow);
+            nodes.displayX.push_back(from.displayX[row]);
+            nodes.displayY.push_back(from.displayY[row]);
+            nodes.displayWidth.push_back(from.displayWidth[row]);
+            nodes.displayHeight.push_back(from.displayHeight[row]);
+            nodes.name.push_back(copyString(from.name[row]));
+            nodes.text.push_back(copyString(from.text[row]));
+            nodes.hint.push_back(copyString(from.hint[row]));
+            frame.typeObjects.push_back(typeObject);
+            frame.footprints.push_back(footprint);
+            auto childrenBegin = row == 0 ? 0 : previous.childrenEnd[row - 1];
+            frame.children.insert(frame.children.end(), previous.children.begin() + childrenBegin,
+                                  previous.children.begin() + previous.childrenEnd[row]);
+            frame.childrenEnd.push_back((uint32_t) frame.children.size());
+            frame.reusedNodes += 1;
+            return true;
+        }
+
+        [[nodiscard]] inline uint64_t hashUINodeFootprint(const UINodeFootprint &footprint) const {
+            auto hash = hashPythonDict(footprint.dict) ^ std::rotl(hashPythonDict(footprint.childrenDict), 21) ^
+                        std::rotl(hashPythonList(footprint.childrenList), 42);
+            for (SIZE_T i = 0; i < footprint.values.size(); i++) {
+                if (footprint.values[i] != nullptr) {
+                    hash ^= std::rotl(hashPythonValue(footprint.values[i], maxUITextLength), (int) (7 * i + 3));
+                }
+            }
+            return hash;
+        }
+
+        /**
+         * Appends the items of `children._childrenObjects` to `children`.
+         */
+        inline void readUIChildren(PVOID childrenObjectAddress, UINodeFootprint &footprint,
+                                   std::vector<PVOID> &children) {
+            auto dictAddress = readCachedValue<PVOID>((LPBYTE) childrenObjectAddress + uiNodeDictOffset);
+            if (!dictAddress.has_value()) {
+                return;
+            }
+            footprint.childrenDict = *dictAddress;
+            static thread_local std::vector<DictEntry> entries;
+            entries.clear();
+            if (!readPythonDict(*dictAddress, childrenListKeys, childrenListKeyIds, entries) || entries.empty()) {
+                return;
+            }
+            footprint.childrenList = entries.front().value;
+            readPythonList(entries.front().value, children);
+        }
+
+        inline void appendUINodes(const UITreeFrame &nodes, uint16_t depth, UITreeFrame &frame,
+                                  std::unordered_map<PVOID, uint32_t> &typeIds) {
+            auto &from = nodes.tree;
+            auto &tree = frame.tree;
+            auto poolOffset = (uint32_t) tree.stringPool.size();
+            auto rebase = [poolOffset](StringRef ref) {
+                return StringRef{ref.offset + poolOffset, ref.length};
+            };
+            auto childrenOffset = (uint32_t) frame.children.size();
+            tree.stringPool.append(from.stringPool);
+            frame.children.insert(frame.children.end(), nodes.children.begin(), nodes.children.end());
+            for (SIZE_T row = 0; row < from.size(); row++) {
+                auto [typeId, inserted] = typeIds.try_emplace(nodes.typeObjects[row], (uint32_t) tree.typeNames.size());
+                if (inserted) {
+                    tree.typeNames.emplace_back(getPythonTypeObjectName(nodes.typeObjects[row]));
+                }
+                frame.rows.emplace(from.address[row], (uint32_t) tree.size());
+                tree.address.push_back(from.address[row]);
+                tree.parent.push_back(from.parent[row]);
+                tree.depth.push_back(depth);
+                tree.typeId.push_back(typeId->second);
+                tree.displayX.push_back(from.displayX[row]);
+                tree.displayY.push_back(from.displayY[row]);
+                tree.displayWidth.push_back(from.displayWidth[row]);
+                tree.displayHeight.push_back(from.displayHeight[row]);
+                tree.name.push_back(rebase(from.name[row]));
+                tree.text.push_back(rebase(from.text[row]));
+                tree.hint.push_back(rebase(from.hint[row]));
+                frame.typeObjects.push_back(nodes.typeObjects[row]);
+                frame.footprints.push_back(nodes.footprints[row]);
+                frame.childrenEnd.push_back(childrenOffset + nodes.childrenEnd[row]);
+            }
+            frame.decodedNodes += nodes.decodedNodes;
+            frame.reusedNodes += nodes.reusedNodes;
+        }
+
+        static inline void diffUITreeFrames(const UITreeFrame &previous, const UITreeFrame &current,
+                                            UITreeDelta &delta) {
+            delta.clear();
+            delta.decodedNodes = current.decodedNodes;
+            delta.reusedNodes = current.reusedNodes;
+            auto &before = previous.tree, &after = current.tree;
+            auto parentAddress = [](const UITree &tree, uint32_t row) {
+                return tree.parent[row] == UITree::noParent ? nullptr : tree.address[tree.parent[row]];
+            };
+            // Bitwise, so that NaN (property missing) equals NaN.
+            auto sameNumber = [](double a, double b) {
+                return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+            };
+            auto property = [](bool differs, UIProperty bit) {
+                return differs ? (uint32_t) bit : 0u;
+            };
+            for (uint32_t row = 0; row < after.size(); row++) {
+                auto previousRow = previous.rows.find(after.address[row]);
+                if (previousRow == previous.rows.end() ||
+                    previous.typeObjects[previousRow->second] != current.typeObjects[row]) {
+                    delta.added.push_back(row);
+                    continue;
+                }
+                auto old = previousRow->second;
+                uint32_t changes = 0;
+                changes |= property(parentAddress(before, old) != parentAddress(after, row), uiParent);
+                changes |= property(!sameNumber(before.displayX[old], after.displayX[row]), uiDisplayX);
+                changes |= property(!sameNumber(before.displayY[old], after.displayY[row]), uiDisplayY);
+                changes |= property(!sameNumber(before.displayWidth[old], after.displayWidth[row]), uiDisplayWidth);
+                changes |= property(!sameNumber(before.displayHeight[old], after.displayHeight[row]), uiDisplayHeight);
+                changes |= property(before.string(before.name[old]) != after.string(after.name[row]), uiName);
+                changes |= property(before.string(before.text[old]) != after.string(after.text[row]), uiText);
+                changes |= property(before.string(before.hint[old]) != after.string(after.hint[row]), uiHint);
+                if (changes != 0) {
+                    delta.changed.push_back(row);
+                    delta.changedProperties.push_back(changes);
+                }
+            }
+            for (uint32_t row = 0; row < before.size(); row++) {
+                auto currentRow = current.rows.find(before.address[row]);
+                if (currentRow == current.rows.end() ||
+                    current.typeObjects[currentRow->second] != previous.typeObjects[row]) {
+                    delta.removed.push_back(before.address[row]);
+                }
+            }
+        }
+
+        UITreeFrame previousUIFrame;
+        UITreeFrame currentUIFrame;
+
         PUSP pythonUIRootTypes = nullptr;
         PUSP pythonUIRootObjects = nullptr;
         PMMR eveObjectRegions = nullptr;
         std::map<PVOID, string> eveTypesMapping = {};
+        static constexpr TypeNameTable eveTypeNames{std::array{"UIRoot"sv}};
 
-        const std::unordered_set<std::string> DictEntriesOfInterestKeys = {
-                "_top", "_left", "_width", "_height", "_displayX", "_displayY",
-                "_displayHeight", "_displayWidth",
-                "_name", "_text", "_setText",
-                "children",
-                "texturePath", "_bgTexturePath",
-                "_hint", "_display",
+        static constexpr TypeNameTable DictEntriesOfInterestKeys{std::array{
+                "_top"sv, "_left"sv, "_width"sv, "_height"sv, "_displayX"sv, "_displayY"sv,
+                "_displayHeight"sv, "_displayWidth"sv,
+                "_name"sv, "_text"sv, "_setText"sv,
+                "children"sv,
+                "texturePath"sv, "_bgTexturePath"sv,
+                "_hint"sv, "_display"sv,
 
                 //  HPGauges
-                "lastShield", "lastArmor", "lastStructure",
+                "lastShield"sv, "lastArmor"sv, "lastStructure"sv,
 
                 //  Found in "ShipHudSpriteGauge"
-                "_lastValue",
+                "_lastValue"sv,
 
                 //  Found in "ModuleButton"
-                "ramp_active",
+                "ramp_active"sv,
 
                 //  Found in the Transforms contained in "ShipModuleButtonRamps"
-                "_rotation",
+                "_rotation"sv,
 
                 //  Found under OverviewEntry in Sprite named "iconSprite"
-                "_color",
+                "_color"sv,
 
                 //  Found in "SE_TextlineCore"
-                "_sr",
+                "_sr"sv,
 
                 //  Found in "_sr" Bunch
-                "htmlstr",
+                "htmlstr"sv,
 
                 // 2023-01-03 Sample with PhotonUI: process-sample-ebdfff96e7.zip
-                "_texturePath", "_opacity", "_bgColor", "isExpanded"
-        };
+                "_texturePath"sv, "_opacity"sv, "_bgColor"sv, "isExpanded"sv
+        }};
+        DictKeyCache dictKeyIds;
+        static constexpr TypeNameTable childrenListKeys{std::array{"_childrenObjects"sv}};
+        DictKeyCache childrenListKeyIds;
+        static constexpr TypeNameTable colorKeys{std::array{"_r"sv, "_g"sv, "_b"sv, "_a"sv}};
+        DictKeyCache colorKeyIds;
 
 
+        /**
+         * Takes the UIRoot type from the discovery cache if it still checks out.
+         */
+        inline bool restoreUIRootType() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::discoveryRestore);
+            if (!cachedDiscovery.has_value()) {
+                return false;
+            }
+            auto types = cachedDiscovery->find("UIRoot");
+            if (types == nullptr || types->size() != 1 || !isTypeObjectNamed(types->front(), *pythonTypes, "UIRoot"sv)) {
+                return false;
+            }
+            pythonUIRootTypes = std::make_unique<USP>(types->begin(), types->end());
+            discovery.addresses["UIRoot"] = *types;
+            return true;
+        }
+
+        /**
+         * Takes the UIRoot objects from the discovery cache if they are all still of the UIRoot type.
+         */
+        inline bool restoreUIRootObjects() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::discoveryRestore);
+            auto objects = cachedDiscovery->find("UIRootObject");
+            if (objects == nullptr || objects->empty()) {
+                return false;
+            }
+            for (auto object: *objects) {
+                auto pyObject = readCachedValue<py27::PyObject>(object);
+                if (!pyObject.has_value() || !pythonUIRootTypes->contains(pyObject->ob_type)) {
+                    return false;
+                }
+            }
+            pythonUIRootObjects = std::make_unique<USP>(objects->begin(), objects->end());
+            discovery.addresses["UIRootObject"] = *objects;
+            return true;
+        }
+
         inline void setEVEObjectRegions(PVOID UIRootAddr) {
             if (this->eveObjectRegions != nullptr) {
                 return;
@@ -108,7 +628,7 @@ namespace eve {
             eveObjectAddrMax = eveObjectAddrMin + ~eveTypeAddrMask;
             for (auto &[_, region]: *committedRegions) {
                 if ((uint64_t) region->baseAddress >= eveObjectAddrMax ||
-                    (uint64_t) region->baseAddress + region->content.size() <= eveObjectAddrMin) {
+                    (uint64_t) region->baseAddress + region->regionSize <= eveObjectAddrMin) {
                     continue;
                 }
                 eveRegionsFiltered->insert(std::pair<PVOID, SPMR>(region->baseAddress, region));
@@ -118,14 +638,36 @@ namespace eve {
             << std::format("eve type regions located @ 0x{:X} - 0x{:X}", eveObjectAddrMin, eveObjectAddrMax);
         }
 
-//    static std::map<std::string, std::function<uint64_t, LocalMemoryReadingTools, object>> specializedReadingFromPythonType =
-//    ImmutableDictionary<string, Func<ulong, LocalMemoryReadingTools, object>>.Empty
-//    .Add("str", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_str))
-//    .Add("unicode", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_unicode))
-//    .Add("int", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_int))
-//    .Add("bool", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_bool))
-//    .Add("float", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_float))
-//    .Add("PyColor", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_PyColor))
-//    .Add("Bunch", new Func<ulong, LocalMemoryReadingTools, object>(ReadingFromPythonType_Bunch));
+        /**
+         * PyColor keeps its channels in its __dict__ as _r, _g, _b and _a.
+         */
+        static inline bool decodePyColor(PythonMemoryReader &reader, PVOID address, PyValue &value, PyValueBuffer &) {
+            auto &eveReader = static_cast<EVEOnlineReader &>(reader);
+            auto dictAddress = reader.readCachedValue<PVOID>((LPBYTE) address + uiNodeDictOffset);
+            static thread_local std::vector<DictEntry> entries;
+            entries.clear();
+            if (!dictAddress.has_value() ||
+                !reader.readPythonDict(*dictAddress, colorKeys, eveReader.colorKeyIds, entries)) {
+                return false;
+            }
+            value.kind = PyValueKind::color;
+            value.rgba = {0, 0, 0, 1};
+            for (auto &[keyId, channel]: entries) {
+                value.rgba[keyId] = (float) reader.readPythonNumber(channel).value_or(0);
+            }
+            return true;
+        }
+
+        /**
+         * Bunch is a dict subclass, its entries are where a dict keeps them.
+         */
+        static inline bool decodeBunch(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                       PyValueBuffer &buffer) {
+            if (!decodeDict(reader, address, value, buffer)) {
+                return false;
+            }
+            value.kind = PyValueKind::bunch;
+            return true;
+        }
     };
 }
\ No newline at end of file
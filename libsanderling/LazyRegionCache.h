@@ -0,0 +1,424 @@
+//
+// Created by allan on 2024/4/13.
+//
+
+#pragma once
+
+#include "ProcessMemorySource.h"
+#include "RegionIndex.h"
+#include "PageHash.h"
+#include "WorkerPool.h"
+#include "ReaderStats.h"
+#include "ReadPlanner.h"
+
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace eve {
+
+    struct CacheOptions {
+        // Fetch region contents block by block on first access instead of copying the whole process up front.
+        bool lazy = false;
+        // Upper bound for the bytes held by lazily fetched blocks.
+        SIZE_T byteBudget = 512ull * 1024 * 1024;
+        SIZE_T blockSize = 256 * 1024;
+        // Eager mode: back the region arena with transparent huge pages, and optionally prefault all of it.
+        bool arenaHugePages = true;
+        bool arenaPrefault = false;
+        // Directory of the discovery cache (see DiscoveryCache), empty to always run the full discovery.
+        std::string discoveryCacheDirectory{};
+        // Start with the per-stage counters and timers enabled, see ProcessMemoryReader::getStats().
+        bool collectStats = false;
+    };
+
+    /**
+     * Block cache behind the lazy mode of ProcessMemoryReader. Blocks are blockSize aligned to their region base,
+     * fetched on first access and evicted by a clock sweep once the byte budget is exceeded: hits only set the
+     * block's access bit under a shared lock, the sweep spares blocks whose bit was set since it last passed.
+     *
+     * view() returns spans into blocks that stay pinned by the calling thread for its next pinsPerThread - 1 block
+     * lookups, even if the block is evicted or refreshed in the meantime. Ranges straddling blocks are copied out
+     * of the resident blocks into a per-thread scratch buffer that stays valid just as long.
+     */
+    class LazyRegionCache {
+    public:
+        static constexpr SIZE_T pinsPerThread = 8;
+
+        /**
+         * Block fetches are counted in `instrumentation` when given.
+         */
+        LazyRegionCache(const ProcessMemorySource &source, SIZE_T blockSize, SIZE_T byteBudget,
+                        ReaderInstrumentation *instrumentation = nullptr) :
+                source(source), blockSize(std::max<SIZE_T>(blockSize, cachePageSize)), budget(byteBudget),
+                instrumentation(instrumentation) {
+            bumpGeneration();
+        }
+
+        /**
+         * Pins of other threads can not be reached from here, they never match again because generations are unique
+         * across caches, even for a new cache at the same address.
+         */
+        ~LazyRegionCache() {
+            for (auto &pinned: pins) {
+                if (pinned.owner == this) {
+                    pinned = {};
+                }
+            }
+        }
+
+        LazyRegionCache(const LazyRegionCache &) = delete;
+
+        LazyRegionCache &operator=(const LazyRegionCache &) = delete;
+
+        inline std::span<const byte> view(const RegionIndexEntry &region, uint64_t offset, SIZE_T length) {
+            auto end = std::min<uint64_t>(offset + length, region.size);
+            auto blockOffset = offset - offset % blockSize;
+            auto blockAddress = region.baseAddress + blockOffset;
+            if (end <= blockOffset + blockSize) {
+                if (auto pinned = findPin(blockAddress)) {
+                    return std::span<const byte>(*pinned).subspan(offset - blockOffset, end - offset);
+                }
+                auto bytes = lookup(blockAddress, blockLength(region, blockOffset));
+                if (bytes == nullptr) {
+                    return {};
+                }
+                pin(blockAddress, bytes);
+                return std::span<const byte>(*bytes).subspan(offset - blockOffset, end - offset);
+            }
+            // Straddles blocks: stitched together in the scratch buffer of the pin slot the range takes next.
+            auto &buffer = scratch[nextPin];
+            if (buffer == nullptr) {
+                buffer = std::make_shared<std::vector<byte>>();
+            }
+            buffer->resize(end - offset);
+            for (auto position = offset; position < end;) {
+                auto partOffset = position - position % blockSize;
+                auto partAddress = region.baseAddress + partOffset;
+                SPBYTES held;
+                auto part = findPin(partAddress);
+                if (part == nullptr) {
+                    held = lookup(partAddress, blockLength(region, partOffset));
+                    part = held.get();
+                }
+                if (part == nullptr) {
+                    return {};
+                }
+                auto partEnd = std::min<uint64_t>(end, partOffset + part->size());
+                std::memcpy(buffer->data() + (position - offset), part->data() + (position - partOffset),
+                            partEnd - position);
+                position = partEnd;
+            }
+            pin(0, buffer);
+            return *buffer;
+        }
+
+        /**
+         * Fetches the blocks overlapping `ranges` that are not resident yet with one planned read (see ReadPlanner)
+         * instead of one read per block on first access. `regionOf(address)` returns the region index entry of an
+         * address, nullptr if it has none.
+         */
+        template<class F>
+        inline void prefetch(std::span<const PageRange> ranges, F &&regionOf) {
+            static thread_local ReadPlanner planner;
+            static thread_local std::vector<PageRange> missing;
+            planner.clear();
+            missing.clear();
+            for (auto &range: ranges) {
+                const RegionIndexEntry *region = regionOf((uint64_t) range.address);
+                if (region == nullptr || region->content != nullptr) {
+                    continue;
+                }
+                auto offset = (uint64_t) range.address - region->baseAddress;
+                auto end = std::min<uint64_t>(offset + range.length, region->size);
+                for (auto blockOffset = offset - offset % blockSize; blockOffset < end; blockOffset += blockSize) {
+                    missing.push_back({(PVOID) (region->baseAddress + blockOffset),
+                                       std::min<SIZE_T>(blockSize, region->size - blockOffset)});
+                }
+            }
+            std::sort(missing.begin(), missing.end(), [](const PageRange &a, const PageRange &b) {
+                return a.address < b.address;
+            });
+            auto duplicates = std::ranges::unique(missing, {}, &PageRange::address);
+            missing.erase(duplicates.begin(), duplicates.end());
+            {
+                std::shared_lock lock(mutex);
+                std::erase_if(missing, [this](const PageRange &block) {
+                    return blocks.contains((uint64_t) block.address);
+                });
+            }
+            if (missing.empty()) {
+                return;
+            }
+            for (auto &block: missing) {
+                planner.add(block.address, block.length);
+            }
+            planner.execute(source);
+            SIZE_T bytesRead = 0, failures = 0;
+            for (SIZE_T i = 0; i < missing.size(); i++) {
+                auto view = planner.view(i);
+                if (view.empty()) {
+                    failures += 1;
+                    continue;
+                }
+                bytesRead += view.size();
+                insert((uint64_t) missing[i].address, std::make_shared<std::vector<byte>>(view.begin(), view.end()));
+            }
+            if (instrumentation != nullptr) {
+                instrumentation->add(StageCounter::bytesRead, bytesRead);
+                instrumentation->add(StageCounter::readFailures, failures);
+                instrumentation->add(StageCounter::allocations, missing.size() - failures);
+            }
+        }
+
+        inline void clear() {
+            std::lock_guard lock(mutex);
+            blocks.clear();
+            clock.clear();
+            clockHand = 0;
+            residentBytes = 0;
+            bumpGeneration();
+        }
+
+        /**
+         * Forgets every block overlapping [address, address + length), e.g. of a freed or resized region.
+         */
+        inline void drop(uint64_t address, SIZE_T length) {
+            std::lock_guard lock(mutex);
+            for (auto it = blocks.begin(); it != blocks.end();) {
+                auto &block = it->second;
+                if (block.address < address + length && address < block.address + block.bytes->size()) {
+                    it = remove(it);
+                } else {
+                    it++;
+                }
+            }
+            bumpGeneration();
+        }
+
+        /**
+         * Fetches every resident block accepted by `shouldRefresh` again and replaces the ones whose pages changed.
+         * Changed pages are appended to `changedPages`.
+         */
+        inline void refresh(WorkerPool &workerPool, const std::function<bool(uint64_t)> &shouldRefresh,
+                            std::vector<PageRange> &changedPages) {
+            struct Resident {
+                uint64_t address;
+                SIZE_T length;
+                std::vector<uint64_t> pageHashes;
+            };
+            std::vector<Resident> residents;
+            {
+                std::shared_lock lock(mutex);
+                for (auto &[address, block]: blocks) {
+                    if (shouldRefresh(address)) {
+                        residents.push_back({address, block.bytes->size(), block.pageHashes});
+                    }
+                }
+            }
+            auto residentChanges = std::vector<std::vector<PageRange>>(residents.size());
+            workerPool.parallelFor(residents.size(), [&](SIZE_T i) {
+                auto &resident = residents[i];
+                auto fresh = std::make_shared<std::vector<byte>>(resident.length);
+                if (readWithRetries(resident.address, fresh->data(), resident.length) != resident.length) {
+                    return;
+                }
+                auto &changes = residentChanges[i];
+                diffPages(fresh->data(), resident.length, resident.pageHashes, [&](SIZE_T offset, SIZE_T length) {
+                    appendPageRange(changes, (PVOID) (resident.address + offset), length);
+                });
+                if (changes.empty()) {
+                    return;
+                }
+                std::lock_guard lock(mutex);
+                auto block = blocks.find(resident.address);
+                if (block != blocks.end()) {
+                    block->second.bytes = std::move(fresh);
+                    block->second.pageHashes = std::move(resident.pageHashes);
+                }
+            });
+            for (auto &changes: residentChanges) {
+                changedPages.insert(changedPages.end(), changes.begin(), changes.end());
+            }
+            bumpGeneration();
+        }
+
+        inline void setByteBudget(SIZE_T byteBudget) {
+            std::lock_guard lock(mutex);
+            budget = byteBudget;
+            evict();
+        }
+
+        [[nodiscard]] inline SIZE_T getByteBudget() const {
+            std::shared_lock lock(mutex);
+            return budget;
+        }
+
+        [[nodiscard]] inline SIZE_T getResidentBytes() const {
+            std::shared_lock lock(mutex);
+            return residentBytes;
+        }
+
+    private:
+        typedef std::shared_ptr<const std::vector<byte>> SPBYTES;
+
+        struct Block {
+            uint64_t address = 0;
+            SPBYTES bytes;
+            std::vector<uint64_t> pageHashes;
+            // Index in `clock`.
+            SIZE_T clockPosition = 0;
+            // Set by every hit, cleared by the clock hand passing by.
+            std::atomic<bool> referenced = false;
+        };
+
+        typedef std::unordered_map<uint64_t, Block> Blocks;
+
+        // No default member initializers, see RegionIndex::LastHit.
+        struct Pin {
+            const LazyRegionCache *owner;
+            uint64_t generation;
+            uint64_t address;
+            SPBYTES bytes;
+        };
+
+        const ProcessMemorySource &source;
+        SIZE_T blockSize;
+        SIZE_T budget;
+        ReaderInstrumentation *instrumentation;
+        SIZE_T residentBytes = 0;
+        Blocks blocks;
+        // Addresses of the resident blocks, swept round by clockHand when evicting.
+        std::vector<uint64_t> clock;
+        SIZE_T clockHand = 0;
+        // Shared for hits, exclusive for everything that adds, removes or replaces blocks.
+        mutable std::shared_mutex mutex;
+        std::atomic<uint64_t> generation = 0;
+
+        static inline std::atomic<uint64_t> nextGeneration = 0;
+
+        static inline thread_local std::array<Pin, pinsPerThread> pins;
+        static inline thread_local SIZE_T nextPin = 0;
+        // Indexed like pins, ranges straddling blocks are copied into the one of the pin slot they take.
+        static inline thread_local std::array<std::shared_ptr<std::vector<byte>>, pinsPerThread> scratch;
+
+        inline void bumpGeneration() {
+            generation.store(nextGeneration.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * The block at `blockAddress` if the calling thread still pins it, without touching the shared state.
+         */
+        [[nodiscard]] inline const std::vector<byte> *findPin(uint64_t blockAddress) const {
+            auto currentGeneration = generation.load(std::memory_order_acquire);
+            for (auto &pinned: pins) {
+                if (pinned.owner == this && pinned.generation == currentGeneration && pinned.address == blockAddress) {
+                    return pinned.bytes.get();
+                }
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] inline SIZE_T blockLength(const RegionIndexEntry &region, uint64_t blockOffset) const {
+            return std::min<uint64_t>(blockSize, region.size - blockOffset);
+        }
+
+        inline void pin(uint64_t address, const SPBYTES &bytes) {
+            pins[nextPin] = {this, address == 0 ? 0 : generation.load(std::memory_order_acquire), address, bytes};
+            nextPin = (nextPin + 1) % pinsPerThread;
+        }
+
+        inline SIZE_T readWithRetries(uint64_t address, byte *buffer, SIZE_T length) const {
+            SIZE_T bytesRead = 0;
+            int tries = 0;
+            do {
+                bytesRead = source.read((PVOID) address, buffer, length);
+                tries += 1;
+            } while (tries <= 3 and bytesRead != length);
+            if (instrumentation != nullptr) {
+                instrumentation->add(StageCounter::bytesRead, bytesRead);
+                instrumentation->add(StageCounter::readRetries, tries - 1);
+                instrumentation->add(StageCounter::readFailures, bytesRead != length);
+                instrumentation->add(StageCounter::allocations);
+            }
+            return bytesRead;
+        }
+
+        inline SPBYTES fetch(uint64_t address, SIZE_T length) const {
+            auto bytes = std::make_shared<std::vector<byte>>(length);
+            if (readWithRetries(address, bytes->data(), length) != length) {
+                return nullptr;
+            }
+            return bytes;
+        }
+
+        inline SPBYTES lookup(uint64_t blockAddress, SIZE_T blockLength) {
+            {
+                std::shared_lock lock(mutex);
+                auto block = blocks.find(blockAddress);
+                if (block != blocks.end()) {
+                    block->second.referenced.store(true, std::memory_order_relaxed);
+                    return block->second.bytes;
+                }
+            }
+            // Read without holding the lock, another thread may fetch the same block meanwhile.
+            auto bytes = fetch(blockAddress, blockLength);
+            if (bytes == nullptr) {
+                return nullptr;
+            }
+            return insert(blockAddress, std::move(bytes));
+        }
+
+        /**
+         * Makes freshly read `bytes` the block at `blockAddress`, unless another thread was first. Returns the
+         * resident block.
+         */
+        inline SPBYTES insert(uint64_t blockAddress, SPBYTES bytes) {
+            std::vector<uint64_t> pageHashes;
+            diffPages(bytes->data(), bytes->size(), pageHashes, [](SIZE_T, SIZE_T) {});
+
+            std::lock_guard lock(mutex);
+            auto [block, inserted] = blocks.try_emplace(blockAddress);
+            if (!inserted) {
+                block->second.referenced.store(true, std::memory_order_relaxed);
+                return block->second.bytes;
+            }
+            block->second.address = blockAddress;
+            block->second.bytes = bytes;
+            block->second.pageHashes = std::move(pageHashes);
+            block->second.clockPosition = clock.size();
+            block->second.referenced.store(true, std::memory_order_relaxed);
+            clock.push_back(blockAddress);
+            residentBytes += bytes->size();
+            evict();
+            return bytes;
+        }
+
+        /**
+         * Sweeps the clock hand until the budget is kept: a block whose access bit is set gets another round,
+         * the first one without is evicted. Ends within two rounds, the first clears every bit.
+         */
+        inline void evict() {
+            while (residentBytes > budget && clock.size() > 1) {
+                clockHand %= clock.size();
+                auto block = blocks.find(clock[clockHand]);
+                if (block->second.referenced.exchange(false, std::memory_order_relaxed)) {
+                    clockHand += 1;
+                    continue;
+                }
+                remove(block);
+            }
+        }
+
+        /**
+         * Forgets a block, the last one in `clock` takes its place there.
+         */
+        inline Blocks::iterator remove(Blocks::iterator block) {
+            auto position = block->second.clockPosition;
+            clock[position] = clock.back();
+            blocks.find(clock[position])->second.clockPosition = position;
+            clock.pop_back();
+            residentBytes -= block->second.bytes->size();
+            return blocks.erase(block);
+        }
+    };
+}
@@ -0,0 +1,136 @@
+//
+// Created by allan on 2024/4/6.
+//
+
+#pragma once
+
+#ifdef __linux__
+
+#include "ProcessMemorySource.h"
+
+#include <fstream>
+#include <sstream>
+#include <climits>
+#include <sys/uio.h>
+#include <signal.h>
+
+namespace eve {
+
+    /**
+     * Reads a (Wine/Proton hosted) client through /proc/<pid>/maps and process_vm_readv.
+     * Requires ptrace access to the target, i.e. same uid with ptrace_scope <= 1 or CAP_SYS_PTRACE.
+     */
+    class LinuxProcessMemorySource : public ProcessMemorySource {
+    public:
+        explicit LinuxProcessMemorySource(DWORD processId) : pid(processId) {}
+
+        [[nodiscard]] bool isOpen() const override {
+            return pid != 0 && kill((pid_t) pid, 0) == 0;
+        }
+
+        [[nodiscard]] DWORD processId() const override {
+            return pid;
+        }
+
+        /**
+         * starttime of /proc/<pid>/stat, in clock ticks since boot.
+         */
+        [[nodiscard]] uint64_t processStartTime() const override {
+            std::ifstream stat(std::format("/proc/{}/stat", pid));
+            std::string line;
+            if (!std::getline(stat, line)) {
+                return 0;
+            }
+            // comm may contain spaces and parentheses, the fields after it start at the last ')'.
+            auto commEnd = line.rfind(')');
+            if (commEnd == std::string::npos) {
+                return 0;
+            }
+            std::istringstream fields(line.substr(commEnd + 1));
+            std::string field;
+            // state is field 3, starttime field 22.
+            for (int i = 3; i < 22; i++) {
+                fields >> field;
+            }
+            uint64_t startTime = 0;
+            fields >> startTime;
+            return startTime;
+        }
+
+        [[nodiscard]] std::vector<MemoryRegionInfo> enumerateReadableRegions() const override {
+            std::vector<MemoryRegionInfo> regions;
+            std::ifstream maps(std::format("/proc/{}/maps", pid));
+            std::string line;
+            while (std::getline(maps, line)) {
+                uint64_t begin = 0, end = 0;
+                std::string perms, offset, device, inode, path;
+                char dash;
+                std::istringstream fields(line);
+                if (!(fields >> std::hex >> begin >> dash >> end >> perms >> offset >> device >> inode)) {
+                    continue;
+                }
+                std::getline(fields >> std::ws, path);
+                if (perms[0] != 'r' || end <= begin) {
+                    continue;
+                }
+                // Kernel provided pages which process_vm_readv refuses to read.
+                if (path == "[vvar]" || path == "[vsyscall]" || path == "[vvar_vclock]") {
+                    continue;
+                }
+                regions.push_back({(PVOID) begin, (SIZE_T) (end - begin)});
+            }
+            return regions;
+        }
+
+        SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const override {
+            iovec local = {buffer, length};
+            iovec remote = {address, length};
+            auto result = process_vm_readv((pid_t) pid, &local, 1, &remote, 1, 0);
+            return result < 0 ? 0 : (SIZE_T) result;
+        }
+
+        /**
+         * Issues up to IOV_MAX requests per process_vm_readv. The syscall stops at the first remote iovec it
+         * cannot read completely, so the remainder of a batch is resubmitted from the request after the failed one.
+         */
+        void readBatch(std::span<MemoryReadRequest> requests) const override {
+            std::vector<iovec> local, remote;
+            local.reserve(std::min<SIZE_T>(requests.size(), IOV_MAX));
+            remote.reserve(std::min<SIZE_T>(requests.size(), IOV_MAX));
+
+            SIZE_T next = 0;
+            while (next < requests.size()) {
+                auto count = std::min<SIZE_T>(requests.size() - next, IOV_MAX);
+                local.clear();
+                remote.clear();
+                for (auto i = next; i < next + count; i++) {
+                    local.push_back({requests[i].buffer, requests[i].length});
+                    remote.push_back({requests[i].address, requests[i].length});
+                }
+                auto result = process_vm_readv((pid_t) pid, local.data(), count, remote.data(), count, 0);
+                if (result < 0) {
+                    requests[next].bytesRead = read(requests[next].address, requests[next].buffer,
+                                                    requests[next].length);
+                    next += 1;
+                    continue;
+                }
+                auto remaining = (SIZE_T) result;
+                auto i = next;
+                for (; i < next + count; i++) {
+                    auto bytesRead = std::min(remaining, requests[i].length);
+                    requests[i].bytesRead = bytesRead;
+                    remaining -= bytesRead;
+                    if (bytesRead != requests[i].length) {
+                        break;
+                    }
+                }
+                next = i < next + count ? i + 1 : i;
+            }
+        }
+
+    private:
+        DWORD pid = 0;
+    };
+}
+
+#endif
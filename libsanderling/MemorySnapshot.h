@@ -0,0 +1,298 @@
+//
+// Created by allan on 2024/4/7.
+//
+
+#pragma once
+
+#include "ProcessMemorySource.h"
+
+#include <fstream>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eve {
+
+    /**
+     * Snapshot file layout, all integers little endian:
+     *
+     *   SnapshotHeader
+     *   SnapshotRegionEntry[regionCount]      @ tableOffset
+     *   region contents                       @ entry.fileOffset, each aligned to snapshotPageSize
+     *
+     * Page aligned contents let the whole file be mapped once and every region be used in place.
+     */
+    static constexpr char snapshotMagic[8] = {'S', 'D', 'L', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr uint32_t snapshotVersion = 1;
+    static constexpr uint64_t snapshotPageSize = 4096;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t processId;
+        uint64_t pageSize;
+        uint64_t regionCount;
+        uint64_t tableOffset;
+    };
+
+    struct SnapshotRegionEntry {
+        uint64_t baseAddress;
+        uint64_t size;
+        uint64_t fileOffset;
+    };
+
+    struct SnapshotRegion {
+        PVOID baseAddress = nullptr;
+        std::span<const byte> content;
+    };
+
+    class MemorySnapshot {
+    public:
+        static inline uint64_t alignToPage(uint64_t offset) {
+            return (offset + snapshotPageSize - 1) & ~(snapshotPageSize - 1);
+        }
+
+        /**
+         * Regions without content (unreadable when the cache was loaded) are left out.
+         */
+        static inline bool write(const std::string &path, DWORD processId, const std::vector<SnapshotRegion> &regions) {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                LOG_S(ERROR) << std::format("Failed to create snapshot {}.", path);
+                return false;
+            }
+            std::vector<SnapshotRegionEntry> table;
+            table.reserve(regions.size());
+            uint64_t tableOffset = sizeof(SnapshotHeader);
+            uint64_t contentOffset = 0;
+            for (auto &region: regions) {
+                if (region.content.empty()) {
+                    continue;
+                }
+                table.push_back({(uint64_t) region.baseAddress, region.content.size(), 0});
+            }
+            contentOffset = alignToPage(tableOffset + table.size() * sizeof(SnapshotRegionEntry));
+            for (auto &entry: table) {
+                entry.fileOffset = contentOffset;
+                contentOffset = alignToPage(contentOffset + entry.size);
+            }
+
+            SnapshotHeader header{};
+            std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+            header.version = snapshotVersion;
+            header.processId = processId;
+            header.pageSize = snapshotPageSize;
+            header.regionCount = table.size();
+            header.tableOffset = tableOffset;
+            file.write((const char *) &header, sizeof(header));
+            file.write((const char *) table.data(), (std::streamsize) (table.size() * sizeof(SnapshotRegionEntry)));
+
+            auto entry = table.begin();
+            for (auto &region: regions) {
+                if (region.content.empty()) {
+                    continue;
+                }
+                file.seekp((std::streamoff) entry->fileOffset);
+                file.write((const char *) region.content.data(), (std::streamsize) region.content.size());
+                entry++;
+            }
+            // Pad the last region, so every region can be mapped up to a full page.
+            if (!table.empty() && contentOffset > table.back().fileOffset + table.back().size) {
+                file.seekp((std::streamoff) (contentOffset - 1));
+                file.put(0);
+            }
+            file.flush();
+            if (!file) {
+                LOG_S(ERROR) << std::format("Failed to write snapshot {}.", path);
+                return false;
+            }
+            LOG_S(INFO) << std::format("{} regions written to snapshot {}.", table.size(), path);
+            return true;
+        }
+    };
+
+    /**
+     * Read-only, zero-copy source over a snapshot written by MemorySnapshot::write.
+     */
+    class SnapshotMemorySource : public ProcessMemorySource {
+    public:
+        explicit SnapshotMemorySource(const std::string &path) {
+            if (!map(path)) {
+                unmap();
+                return;
+            }
+            auto header = (const SnapshotHeader *) mapping;
+            // Sizes are compared against what is left of the file, sums of untrusted fields could wrap.
+            if (mappingSize < sizeof(SnapshotHeader) ||
+                std::memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+                header->version != snapshotVersion ||
+                header->tableOffset > mappingSize || header->tableOffset % alignof(SnapshotRegionEntry) != 0 ||
+                header->regionCount > (mappingSize - header->tableOffset) / sizeof(SnapshotRegionEntry)) {
+                LOG_S(ERROR) << std::format("{} is not a valid snapshot.", path);
+                unmap();
+                return;
+            }
+            pid = header->processId;
+            table = std::span((const SnapshotRegionEntry *) (mapping + header->tableOffset), header->regionCount);
+            uint64_t previousEnd = 0;
+            for (auto &entry: table) {
+                if (entry.fileOffset > mappingSize || entry.size > mappingSize - entry.fileOffset) {
+                    LOG_S(ERROR) << std::format("Snapshot {} is truncated.", path);
+                    unmap();
+                    return;
+                }
+                // findEntry() searches the table by address.
+                if (entry.baseAddress < previousEnd || entry.size > UINT64_MAX - entry.baseAddress) {
+                    LOG_S(ERROR) << std::format("Snapshot {} has overlapping regions.", path);
+                    unmap();
+                    return;
+                }
+                previousEnd = entry.baseAddress + entry.size;
+            }
+        }
+
+        ~SnapshotMemorySource() override {
+            unmap();
+        }
+
+        SnapshotMemorySource(const SnapshotMemorySource &) = delete;
+
+        SnapshotMemorySource &operator=(const SnapshotMemorySource &) = delete;
+
+        [[nodiscard]] bool isOpen() const override {
+            return mapping != nullptr;
+        }
+
+        [[nodiscard]] DWORD processId() const override {
+            return pid;
+        }
+
+        [[nodiscard]] std::vector<MemoryRegionInfo> enumerateReadableRegions() const override {
+            std::vector<MemoryRegionInfo> regions;
+            regions.reserve(table.size());
+            for (auto &entry: table) {
+                regions.push_back({(PVOID) entry.baseAddress, (SIZE_T) entry.size});
+            }
+            return regions;
+        }
+
+        SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const override {
+            auto entry = findEntry((uint64_t) address);
+            if (entry == nullptr) {
+                return 0;
+            }
+            auto offset = (uint64_t) address - entry->baseAddress;
+            auto bytesRead = std::min<SIZE_T>(length, entry->size - offset);
+            std::memcpy(buffer, mapping + entry->fileOffset + offset, bytesRead);
+            return bytesRead;
+        }
+
+        [[nodiscard]] bool isMapped() const override {
+            return true;
+        }
+
+        /**
+         * The view is mapped read-only, writing through it faults.
+         */
+        [[nodiscard]] std::span<byte> mappedContent(const MemoryRegionInfo &region) const override {
+            auto entry = findEntry((uint64_t) region.baseAddress);
+            if (entry == nullptr || entry->baseAddress != (uint64_t) region.baseAddress) {
+                return {};
+            }
+            return {mapping + entry->fileOffset, std::min<SIZE_T>(entry->size, region.regionSize)};
+        }
+
+    private:
+        DWORD pid = 0;
+        byte *mapping = nullptr;
+        SIZE_T mappingSize = 0;
+        std::span<const SnapshotRegionEntry> table;
+#ifdef _WIN32
+        HANDLE hFile = INVALID_HANDLE_VALUE;
+        HANDLE hMapping = nullptr;
+#endif
+
+        [[nodiscard]] inline const SnapshotRegionEntry *findEntry(uint64_t address) const {
+            auto gt = std::upper_bound(table.begin(), table.end(), address,
+                                       [](uint64_t value, const SnapshotRegionEntry &entry) {
+                                           return value < entry.baseAddress;
+                                       });
+            if (gt == table.begin()) {
+                return nullptr;
+            }
+            auto &entry = *(--gt);
+            if (address - entry.baseAddress >= entry.size) {
+                return nullptr;
+            }
+            return &entry;
+        }
+
+        inline bool map(const std::string &path) {
+#ifdef _WIN32
+            hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (hFile == INVALID_HANDLE_VALUE) {
+                LOG_S(ERROR) << std::format("Failed to open snapshot {}.", path);
+                return false;
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+                return false;
+            }
+            hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (hMapping == nullptr) {
+                return false;
+            }
+            mapping = (byte *) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            mappingSize = (SIZE_T) fileSize.QuadPart;
+#else
+            auto fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                LOG_S(ERROR) << std::format("Failed to open snapshot {}.", path);
+                return false;
+            }
+            struct stat fileStat{};
+            if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+                close(fd);
+                return false;
+            }
+            auto address = mmap(nullptr, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (address == MAP_FAILED) {
+                return false;
+            }
+            mapping = (byte *) address;
+            mappingSize = (SIZE_T) fileStat.st_size;
+#endif
+            return mapping != nullptr;
+        }
+
+        inline void unmap() {
+#ifdef _WIN32
+            if (mapping != nullptr) {
+                UnmapViewOfFile(mapping);
+            }
+            if (hMapping != nullptr) {
+                CloseHandle(hMapping);
+                hMapping = nullptr;
+            }
+            if (hFile != INVALID_HANDLE_VALUE) {
+                CloseHandle(hFile);
+                hFile = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (mapping != nullptr) {
+                munmap(mapping, mappingSize);
+            }
+#endif
+            mapping = nullptr;
+            mappingSize = 0;
+            table = {};
+        }
+    };
+}
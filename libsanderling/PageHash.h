@@ -0,0 +1,86 @@
+//
+// Created by allan on 2024/4/13.
+//
+
+#pragma once
+
+#include "common.h"
+
+namespace eve {
+
+    static constexpr SIZE_T cachePageSize = 4096;
+
+    struct PageRange {
+        PVOID address = nullptr;
+        SIZE_T length = 0;
+    };
+
+    /**
+     * Appends [address, address + length), merged into the last range when they touch.
+     */
+    inline void appendPageRange(std::vector<PageRange> &ranges, PVOID address, SIZE_T length) {
+        if (!ranges.empty() && (LPBYTE) ranges.back().address + ranges.back().length == (LPBYTE) address) {
+            ranges.back().length += length;
+        } else {
+            ranges.push_back({address, length});
+        }
+    }
+
+    /**
+     * Accumulates one word into a lane, the rotation carries changes of the high bits down so the next multiply
+     * spreads them.
+     */
+    inline uint64_t hashRound(uint64_t lane, uint64_t word) {
+        return std::rotl(lane + word * 0xC2B2AE3D27D4EB4Full, 31) * 0x9E3779B97F4A7C15ull;
+    }
+
+    /**
+     * Murmur3 finalizer, every input bit affects every output bit.
+     */
+    inline uint64_t fmix64(uint64_t hash) {
+        hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDull;
+        hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ull;
+        return hash ^ (hash >> 33);
+    }
+
+    /**
+     * Change detection hash for cached pages. Not cryptographic, four independent xxhash-like lanes so the hash
+     * keeps up with memory bandwidth, each finalized before they are combined.
+     */
+    inline uint64_t hashPage(const byte *page, SIZE_T length) {
+        uint64_t lanes[4] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, length};
+        SIZE_T i = 0;
+        for (; i + 32 <= length; i += 32) {
+            for (auto lane = 0; lane < 4; lane++) {
+                uint64_t word;
+                std::memcpy(&word, page + i + lane * 8, 8);
+                lanes[lane] = hashRound(lanes[lane], word);
+            }
+        }
+        for (; i < length; i++) {
+            lanes[0] = hashRound(lanes[0], page[i]);
+        }
+        return fmix64(lanes[0]) ^ std::rotl(fmix64(lanes[1]), 17) ^ std::rotl(fmix64(lanes[2]), 31) ^
+               std::rotl(fmix64(lanes[3]), 47);
+    }
+
+    /**
+     * Calls onChange(offset, length) for every page of `fresh` whose hash differs from `hashes`, and updates
+     * `hashes` to the fresh content.
+     */
+    template<class F>
+    inline void diffPages(const byte *fresh, SIZE_T length, std::vector<uint64_t> &hashes, F &&onChange) {
+        auto pages = (length + cachePageSize - 1) / cachePageSize;
+        hashes.resize(pages);
+        for (SIZE_T page = 0; page < pages; page++) {
+            auto offset = page * cachePageSize;
+            auto pageLength = std::min(cachePageSize, length - offset);
+            auto hash = hashPage(fresh + offset, pageLength);
+            if (hash == hashes[page]) {
+                continue;
+            }
+            hashes[page] = hash;
+            onChange(offset, pageLength);
+        }
+    }
+}
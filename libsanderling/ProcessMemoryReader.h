@@ -5,6 +5,18 @@
 #pragma once
 
 #include "common.h"
+#include "ProcessMemorySource.h"
+#include "WindowsProcessMemorySource.h"
+#include "LinuxProcessMemorySource.h"
+#include "MemorySnapshot.h"
+#include "RegionIndex.h"
+#include "WorkerPool.h"
+#include "PageHash.h"
+#include "LazyRegionCache.h"
+#include "RegionArena.h"
+#include "ReadPlanner.h"
+
+#include <stdexcept>
 
 namespace eve {
     using namespace std::literals;
@@ -13,20 +25,65 @@ namespace eve {
 
 
     struct MemoryRegion {
-        MemoryRegion(PVOID baseAddress, std::vector<byte> &content) : baseAddress(baseAddress), content(content) {}
+        MemoryRegion(PVOID baseAddress, std::vector<byte> &content) : MemoryRegion(baseAddress, content.size(),
+                                                                                   content.data()) {}
 
-        MemoryRegion(PVOID baseAddress, SIZE_T length) : baseAddress(baseAddress) {
-            this->content = std::vector<byte>(length);
+        /**
+         * Region owning `length` uninitialized bytes, to be filled by a read.
+         */
+        MemoryRegion(PVOID baseAddress, SIZE_T length) : baseAddress(baseAddress), regionSize(length) {
+            this->storage = std::make_unique_for_overwrite<byte[]>(length);
+            this->content = {storage.get(), length};
         }
 
-        MemoryRegion(PVOID baseAddress, SIZE_T length, byte *content) : baseAddress(baseAddress) {
+        MemoryRegion(PVOID baseAddress, SIZE_T length, byte *content) : baseAddress(baseAddress), regionSize(length) {
             if (content != nullptr) {
-                this->content = std::vector<byte>(content, content + length);
+                this->storage = std::make_unique_for_overwrite<byte[]>(length);
+                std::memcpy(storage.get(), content, length);
+                this->content = {storage.get(), length};
             }
         }
 
+        /**
+         * Region backed by memory owned elsewhere (a mapped snapshot, the reader's RegionArena), nothing is copied.
+         */
+        MemoryRegion(PVOID baseAddress, std::span<byte> mappedContent) : baseAddress(baseAddress),
+                                                                          regionSize(mappedContent.size()),
+                                                                          content(mappedContent) {}
+
+        /**
+         * Region without content, fetched on demand through the reader's LazyRegionCache.
+         */
+        explicit MemoryRegion(const MemoryRegionInfo &info) : baseAddress(info.baseAddress),
+                                                              regionSize(info.regionSize), onDemand(true) {}
+
+        MemoryRegion(const MemoryRegion &) = delete;
+
+        MemoryRegion &operator=(const MemoryRegion &) = delete;
+
+        inline void clear() {
+            content = {};
+            storage = nullptr;
+            pageHashes = std::vector<uint64_t>();
+        }
+
+        /**
+         * Bytes that can be read through the cache.
+         */
+        [[nodiscard]] inline SIZE_T cachedSize() const {
+            return onDemand ? regionSize : content.size();
+        }
+
         PVOID baseAddress = nullptr;
-        std::vector<byte> content;
+        // Size in the target process, content is empty when the region could not be read.
+        SIZE_T regionSize = 0;
+        std::span<byte> content;
+        // One hash per cachePageSize bytes of content, used by refreshCache() to find changed pages.
+        std::vector<uint64_t> pageHashes;
+        bool onDemand = false;
+
+    private:
+        std::unique_ptr<byte[]> storage;
     };
 
     typedef MemoryRegion MR;
@@ -42,69 +99,314 @@ namespace eve {
     typedef std::unique_ptr<STR> PSTR;
 
 
+
+    /**
+     * What refreshCache() changed, so derived data (type sets, candidate sets, ...) can be invalidated selectively.
+     */
+    struct CacheDiff {
+        std::vector<MemoryRegionInfo> addedRegions;
+        std::vector<MemoryRegionInfo> removedRegions;
+        // Regions whose size changed, or which could not be read before. They were read again as a whole.
+        std::vector<MemoryRegionInfo> resizedRegions;
+        // Consecutive changed pages of regions that kept their size, sorted by address.
+        std::vector<PageRange> changedPages;
+
+        [[nodiscard]] inline bool hasLayoutChanges() const {
+            return !addedRegions.empty() || !removedRegions.empty() || !resizedRegions.empty();
+        }
+
+        [[nodiscard]] inline bool empty() const {
+            return !hasLayoutChanges() && changedPages.empty();
+        }
+
+        /**
+         * True if any byte of [address, address + length) may have changed.
+         */
+        [[nodiscard]] inline bool touches(PVOID address, SIZE_T length) const {
+            auto begin = (uint64_t) address, end = begin + length;
+            auto overlaps = [begin, end](uint64_t otherBegin, uint64_t otherLength) {
+                return begin < otherBegin + otherLength && otherBegin < end;
+            };
+            for (auto &regions: {&addedRegions, &removedRegions, &resizedRegions}) {
+                for (auto &region: *regions) {
+                    if (overlaps((uint64_t) region.baseAddress, region.regionSize)) {
+                        return true;
+                    }
+                }
+            }
+            auto gt = std::upper_bound(changedPages.begin(), changedPages.end(), begin,
+                                       [](uint64_t value, const PageRange &range) {
+                                           return value < (uint64_t) range.address;
+                                       });
+            if (gt != changedPages.begin() && overlaps((uint64_t) std::prev(gt)->address, std::prev(gt)->length)) {
+                return true;
+            }
+            return gt != changedPages.end() && overlaps((uint64_t) gt->address, gt->length);
+        }
+    };
+
+    /**
+     * Thrown by the reader constructors when the process can not be read, or does not look like what the reader
+     * expects. The reader is not usable afterwards.
+     */
+    class ReaderError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
     class ProcessMemoryReader {
     public:
-        explicit ProcessMemoryReader(DWORD processId, uint8_t numThreads = 4) : processId(processId),
-                                                                                numThreads(numThreads) {
-            hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-            if (hProcess == nullptr) {
+        explicit ProcessMemoryReader(DWORD processId, uint8_t numThreads = 4) : ProcessMemoryReader(
+                openProcessMemorySource(processId), numThreads) {}
+
+        /**
+         * Runs on `workerPool` when given, several readers can share one pool. Otherwise the reader owns a pool of
+         * `numThreads` workers for its lifetime.
+         */
+        explicit ProcessMemoryReader(PMS source, uint8_t numThreads = 4, SPWP workerPool = nullptr,
+                                     CacheOptions cacheOptions = {}) :
+                source(std::move(source)), numThreads(numThreads), workerPool(std::move(workerPool)),
+                cacheOptions(cacheOptions) {
+            if (this->workerPool == nullptr) {
+                this->workerPool = make_shared<WorkerPool>(numThreads);
+            }
+            if (this->source == nullptr || !this->source->isOpen()) {
                 LOG_S(ERROR) << "Failed to open process.";
-                exit(-1);
+                throw ReaderError("Failed to open process.");
+            }
+            processId = this->source->processId();
+            // A mapped snapshot is already lazy, its pages are only faulted in when touched.
+            if (cacheOptions.lazy && !this->source->isMapped()) {
+                lazyCache = make_unique<LazyRegionCache>(*this->source, cacheOptions.blockSize,
+                                                         cacheOptions.byteBudget, &instrumentation);
             }
             reloadCache();
             if (committedRegions == nullptr || committedRegions->empty()) {
                 LOG_S(ERROR) << "Failed to load committed regions.";
-                exit(-1);
+                throw ReaderError("Failed to load committed regions.");
             }
             LOG_S(INFO) << std::format("{} committed regions loaded.", committedRegions->size());
         }
 
-        ~ProcessMemoryReader() {
-            if (hProcess != nullptr) {
-                CloseHandle(hProcess);
-            }
+        ~ProcessMemoryReader() = default;
+
+        [[nodiscard]] inline const SPWP &getWorkerPool() const {
+            return workerPool;
+        }
+
+        /**
+         * Block cache of the lazy mode, nullptr when region contents are copied up front.
+         */
+        [[nodiscard]] inline LazyRegionCache *getLazyCache() const {
+            return lazyCache.get();
+        }
+
+        /**
+         * Regions by base address, replaced by reloadCache() and by refreshCache() when the layout changed. The
+         * contents of the eager mode live in the region arena until the next reloadCache().
+         */
+        [[nodiscard]] inline const MMR &getCommittedRegions() const {
+            return *committedRegions;
+        }
+
+        /**
+         * Wall time and counters per stage since the reader was created or resetStats(), all zero unless stats
+         * are enabled.
+         */
+        [[nodiscard]] inline ReaderStats getStats() const {
+            return instrumentation.snapshot();
+        }
+
+        inline void resetStats() {
+            instrumentation.reset();
+        }
+
+        inline void setStatsEnabled(bool enabled) {
+            instrumentation.setEnabled(enabled);
+        }
+
+        static inline PMS openProcessMemorySource(DWORD processId) {
+#if defined(_WIN32)
+            return make_unique<WindowsProcessMemorySource>(processId);
+#elif defined(__linux__)
+            return make_unique<LinuxProcessMemorySource>(processId);
+#else
+            LOG_S(ERROR) << "No process memory backend for this platform.";
+            return nullptr;
+#endif
         }
 
         inline void reloadCache() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::regionLoad);
             readCommittedRegionsWoContent();
-            readCommittedRegionContents();
+            instrumentation.add(StageCounter::regionsVisited, committedRegions->size());
+            if (lazyCache != nullptr) {
+                lazyCache->clear();
+            } else if (!source->isMapped()) {
+                std::vector<SPMR> regions;
+                regions.reserve(committedRegions->size());
+                for (auto &[_, region]: *committedRegions) {
+                    regions.push_back(region);
+                }
+                readRegionContents(regions);
+            }
+            regionIndex.rebuild(*committedRegions);
         }
 
-        inline PBYTES readCachedBytes(PVOID address, SIZE_T length) const {
+        /**
+         * Incremental reloadCache(): the region list is enumerated again and diffed against the cache. New, resized
+         * and previously unreadable regions are read as a whole. Regions that kept their size are fetched into a
+         * scratch buffer and only pages whose hash changed are copied into the cache. The contents still have to be
+         * fetched to be hashed, the remote process cannot tell us which pages it wrote.
+         *
+         * When `regionsToReread` is given, only those of the unchanged regions are fetched again.
+         *
+         * In lazy mode new and resized regions stay on demand, and only the resident blocks are fetched again.
+         */
+        inline CacheDiff refreshCache(CPMMR regionsToReread = nullptr) {
+            CacheDiff diff;
+            if (source->isMapped() || committedRegions == nullptr) {
+                return diff;
+            }
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::cacheRefresh);
+            auto refreshedRegions = make_unique<MMR>();
+            std::vector<SPMR> wholeRegions, pagedRegions;
+            for (auto &regionInfo: source->enumerateReadableRegions()) {
+                auto existing = committedRegions->find(regionInfo.baseAddress);
+                if (existing != committedRegions->end() && existing->second->regionSize == regionInfo.regionSize &&
+                    existing->second->cachedSize() != 0) {
+                    refreshedRegions->insert(*existing);
+                    if (lazyCache == nullptr &&
+                        (regionsToReread == nullptr || regionsToReread->contains(regionInfo.baseAddress))) {
+                        pagedRegions.push_back(existing->second);
+                    }
+                    continue;
+                }
+                // Not from the arena, it only grows again on the next reloadCache().
+                auto region = lazyCache != nullptr ? std::make_shared<MR>(regionInfo)
+                                                   : std::make_shared<MR>(regionInfo.baseAddress, regionInfo.regionSize);
+                if (existing == committedRegions->end()) {
+                    diff.addedRegions.push_back(regionInfo);
+                } else {
+                    diff.resizedRegions.push_back(regionInfo);
+                }
+                refreshedRegions->insert(std::pair<PVOID, SPMR>(regionInfo.baseAddress, region));
+                if (lazyCache != nullptr) {
+                    lazyCache->drop((uint64_t) regionInfo.baseAddress, regionInfo.regionSize);
+                } else {
+                    wholeRegions.push_back(region);
+                }
+            }
+            for (auto &[baseAddress, region]: *committedRegions) {
+                if (!refreshedRegions->contains(baseAddress)) {
+                    diff.removedRegions.push_back({baseAddress, region->regionSize});
+                    if (lazyCache != nullptr) {
+                        lazyCache->drop((uint64_t) baseAddress, region->regionSize);
+                    }
+                }
+            }
+            if (lazyCache != nullptr) {
+                refreshResidentBlocks(*refreshedRegions, regionsToReread, diff.changedPages);
+            } else {
+                readRegionContents(wholeRegions);
+                refreshRegionPages(pagedRegions, diff.changedPages);
+            }
+
+            committedRegions = std::move(refreshedRegions);
+            regionIndex.rebuild(*committedRegions);
+            LOG_S(INFO) << std::format("cache refreshed: {} added, {} removed, {} resized regions, {} changed ranges.",
+                                       diff.addedRegions.size(), diff.removedRegions.size(),
+                                       diff.resizedRegions.size(), diff.changedPages.size());
+            return diff;
+        }
+
+        /**
+         * True if `address` points into a cached, readable region.
+         */
+        inline bool isCachedAddress(PVOID address) const {
+            return regionIndex.find((uint64_t) address) != nullptr;
+        }
+
+        /**
+         * Writes the cached regions to `path`, it can be reopened later with SnapshotMemorySource.
+         */
+        inline bool saveSnapshot(const std::string &path) const {
             if (committedRegions == nullptr) {
                 LOG_S(WARNING) << "No committed regions loaded.";
-                return nullptr;
+                return false;
             }
-            auto ge = committedRegions->lower_bound(address);
-            if (ge == committedRegions->begin()) {
-                return nullptr;
+            if (lazyCache != nullptr) {
+                LOG_S(ERROR) << "Snapshots need the whole process cached, not available in lazy mode.";
+                return false;
             }
-            const auto &region = (--ge)->second;
+            std::vector<SnapshotRegion> regions;
+            regions.reserve(committedRegions->size());
+            for (auto &[_, region]: *committedRegions) {
+                regions.push_back({region->baseAddress, region->content});
+            }
+            return MemorySnapshot::write(path, processId, regions);
+        }
 
+        /**
+         * View into the cached region content, no copy. Shorter than `length` when the region ends before,
+         * empty when `address` is not cached. Valid until the next reloadCache().
+         *
+         * In lazy mode the view points into a cached block and is only guaranteed to stay valid for the calling
+         * thread's next LazyRegionCache::pinsPerThread - 1 lookups. Copy what has to live longer.
+         */
+        inline std::span<const byte> readCachedSpan(PVOID address, SIZE_T length) const {
+            if (length == 0) {
+                return {};
+            }
+            auto region = regionIndex.find((uint64_t) address);
             if (region == nullptr) {
-                return nullptr;
+                return {};
+            }
+            auto offset = (uint64_t) address - region->baseAddress;
+            if (region->content == nullptr) {
+                return lazyCache->view(*region, offset, length);
+            }
+            return {region->content + offset, std::min<SIZE_T>(length, region->size - offset)};
+        }
+
+        inline std::string_view readCachedNullTerminatedAsciiStringView(PVOID address, SIZE_T maxLength = 255) const {
+            auto bytes = readCachedSpan(address, maxLength);
+            if (bytes.empty()) {
+                return {};
+            }
+            auto chars = std::string_view((const char *) bytes.data(), bytes.size());
+            return chars.substr(0, chars.find('\0'));
+        }
+
+        /**
+         * Copy of a whole `T` out of the cache, std::nullopt unless all sizeof(T) bytes are cached.
+         */
+        template<class T>
+        inline std::optional<T> readCachedValue(PVOID address) const {
+            static_assert(std::is_trivially_copyable_v<T>);
+            auto bytes = readCachedSpan(address, sizeof(T));
+            if (bytes.size() != sizeof(T)) {
+                return std::nullopt;
             }
-            int64_t offset = (LPBYTE) address - (LPBYTE) region->baseAddress;
-            if (offset < 0 || length == 0 || (uint64_t) offset >= region->content.size()) {
+            T value;
+            std::memcpy(&value, bytes.data(), sizeof(T));
+            return value;
+        }
+
+        inline PBYTES readCachedBytes(PVOID address, SIZE_T length) const {
+            auto bytes = readCachedSpan(address, length);
+            if (bytes.empty()) {
                 return nullptr;
             }
-            return make_unique<BYTES>(region->content.begin() + offset,
-                                      region->content.begin() + min(offset + length, region->content.size()));
+            return make_unique<BYTES>(bytes.begin(), bytes.end());
         }
 
         inline PSTR readCachedNullTerminatedAsciiString(PVOID address, SIZE_T maxLength = 255) const {
-            auto bytes = readCachedBytes(address, maxLength);
-            if (bytes == nullptr) {
+            auto chars = readCachedNullTerminatedAsciiStringView(address, maxLength);
+            if (chars.data() == nullptr) {
                 return nullptr;
             }
-            auto nullTerminatorIndex = (int64_t) bytes->size();
-            for (auto i = 0; i < bytes->size(); i++) {
-                if (bytes->at(i) == 0) {
-                    nullTerminatorIndex = i;
-                    break;
-                }
-            }
-            return make_unique<STR>(bytes->begin(), bytes->begin() + nullTerminatorIndex);
+            return make_unique<STR>(chars);
         }
 
         template<class T>
@@ -117,12 +419,31 @@ namespace eve {
             return static_cast<unique_ptr<T[]>>(readCachedBytes(address, sizeof(T) * size));
         }
 
+        /**
+         * Reads the requests queued in `planner` from the live process, merged into as few bulk reads as possible.
+         * Prefer this over many readBytes() calls when the cache is not an option.
+         */
+        inline void readPlanned(ReadPlanner &planner) const {
+            planner.execute(*source);
+        }
+
+        /**
+         * Lazy mode: brings the blocks under `ranges` into the cache with one planned read, before the cached reads
+         * touch them one by one. Nothing to do in eager mode.
+         */
+        inline void prefetchCached(std::span<const PageRange> ranges) const {
+            if (lazyCache == nullptr || ranges.empty()) {
+                return;
+            }
+            lazyCache->prefetch(ranges, [this](uint64_t address) { return regionIndex.find(address); });
+        }
+
         inline unique_ptr<byte[]> readRawBytes(PVOID address, SIZE_T length) const {
             SIZE_T bytesRead;
             auto buffer = make_unique<byte[]>(length);
             int tries = 0;
             do {
-                ReadProcessMemory(hProcess, address, (LPVOID) buffer.get(), length, &bytesRead);
+                bytesRead = source->read(address, (LPVOID) buffer.get(), length);
                 tries += 1;
             } while (tries <= 3 and bytesRead != length);
             if (bytesRead != length) {
@@ -136,7 +457,7 @@ namespace eve {
             auto buffer = make_unique<BYTES>(length);
             int tries = 0;
             do {
-                ReadProcessMemory(hProcess, address, (LPVOID) buffer->data(), length, &bytesRead);
+                bytesRead = source->read(address, (LPVOID) buffer->data(), length);
                 tries += 1;
             } while (tries <= 3 and bytesRead != length);
             if (bytesRead != length) {
@@ -162,7 +483,7 @@ namespace eve {
 
         template<class T>
         inline unique_ptr<T, std::function<void(T*)>> readMemory(PVOID address) const {
-            auto bytes_array = static_cast<T*>(readRawBytes(address, sizeof(T)).release());
+            auto bytes_array = reinterpret_cast<T*>(readRawBytes(address, sizeof(T)).release());
             return unique_ptr<T, std::function<void(T*)>>(bytes_array, [](void* ptr) {delete[] static_cast<byte*>(ptr);});
         }
 
@@ -174,65 +495,242 @@ namespace eve {
 
 
     protected:
+        /**
+         * Slice [beginWord, endWord) of a region's 8 byte words, the unit the scans are scheduled in.
+         */
+        struct ScanChunk {
+            SPMR region;
+            SIZE_T beginWord;
+            SIZE_T endWord;
+        };
+
+        static constexpr SIZE_T scanChunkWords = 128 * 1024;
+
+        /**
+         * Splits the candidate words of `regions` into chunks of at most scanChunkWords, so one huge heap arena
+         * no longer pins a single thread. A candidate at word i looks at words up to i + windowWords - 1: only
+         * indices with a full window inside the region become candidates, the window itself may reach into the
+         * next chunk.
+         */
+        static inline std::vector<ScanChunk> splitIntoScanChunks(const MMR &regions, SIZE_T windowWords) {
+            std::vector<ScanChunk> chunks;
+            for (auto &[_, region]: regions) {
+                if (region == nullptr || region->cachedSize() / 8 < windowWords) {
+                    continue;
+                }
+                auto candidateWords = region->cachedSize() / 8 - windowWords;
+                for (SIZE_T beginWord = 0; beginWord < candidateWords; beginWord += scanChunkWords) {
+                    chunks.push_back({region, beginWord, std::min(beginWord + scanChunkWords, candidateWords)});
+                }
+            }
+            return chunks;
+        }
+
+        /**
+         * Words [beginWord, endWord + windowWords) of a chunk, clamped to the region. Eagerly cached regions are
+         * viewed in place. On demand regions are streamed into a per-thread buffer instead of going through the
+         * block cache, so a full scan does not evict the blocks that are actually being read. The view is valid
+         * until the calling thread loads the next chunk.
+         */
+        inline std::span<const uint64_t> loadScanChunk(const ScanChunk &chunk, SIZE_T windowWords) const {
+            auto &region = *chunk.region;
+            auto endWord = std::min(chunk.endWord + windowWords, region.cachedSize() / 8);
+            if (!region.onDemand) {
+                return std::span((const uint64_t *) region.content.data() + chunk.beginWord, endWord - chunk.beginWord);
+            }
+            static thread_local std::vector<uint64_t> scanBuffer;
+            scanBuffer.resize(endWord - chunk.beginWord);
+            auto length = scanBuffer.size() * 8;
+            SIZE_T bytesRead = 0;
+            int tries = 0;
+            do {
+                bytesRead = source->read((LPBYTE) region.baseAddress + chunk.beginWord * 8, scanBuffer.data(), length);
+                tries += 1;
+            } while (tries <= 3 and bytesRead != length);
+            instrumentation.add(StageCounter::bytesRead, bytesRead);
+            instrumentation.add(StageCounter::readRetries, tries - 1);
+            if (bytesRead != length) {
+                instrumentation.add(StageCounter::readFailures);
+                return {};
+            }
+            return scanBuffer;
+        }
+
+        PMS source = nullptr;
         DWORD processId = 0;
         uint8_t numThreads = 4;
-        HANDLE hProcess = nullptr;
+        SPWP workerPool = nullptr;
+        CacheOptions cacheOptions;
+        // Mutable, the const read paths count too.
+        mutable ReaderInstrumentation instrumentation{cacheOptions.collectStats};
+        unique_ptr<LazyRegionCache> lazyCache = nullptr;
+        // Backs the region contents of the eager mode, reused by every reloadCache().
+        RegionArena arena{cacheOptions.arenaHugePages, cacheOptions.arenaPrefault};
         PMMR committedRegions = nullptr;
+        RegionIndex regionIndex;
 
     private:
+        // Upper bounds for one readBatch call, so batches stay small enough to spread over the threads.
+        static constexpr SIZE_T maxRegionsPerBatch = 1024;
+        static constexpr SIZE_T maxBytesPerBatch = 64 * 1024 * 1024;
+
         inline void readCommittedRegionsWoContent() {
-            LPCVOID address = nullptr;
             committedRegions = std::make_unique<std::map<PVOID, SPMR>>();
-            while (true) {
-                MEMORY_BASIC_INFORMATION memoryInfo;
-                auto result = VirtualQueryEx(hProcess, address, &memoryInfo, sizeof(memoryInfo));
-
-                if (result != sizeof(memoryInfo)) {
-                    break;
+            auto mapped = source->isMapped();
+            auto regionInfos = source->enumerateReadableRegions();
+            auto useArena = !mapped && lazyCache == nullptr;
+            if (useArena) {
+                SIZE_T arenaBytes = 0;
+                for (auto &regionInfo: regionInfos) {
+                    arenaBytes += RegionArena::requiredBytes(regionInfo.regionSize);
                 }
-                address = (LPBYTE) memoryInfo.BaseAddress + memoryInfo.RegionSize;
-                if (memoryInfo.State != MEM_COMMIT || memoryInfo.Protect & PAGE_GUARD ||
-                    memoryInfo.Protect & PAGE_NOACCESS) {
-                    continue;
+                // The previous contents are gone from here on, they are about to be replaced anyway.
+                auto previousCapacity = arena.getCapacity();
+                arena.reset(arenaBytes);
+                instrumentation.add(StageCounter::allocations, arena.getCapacity() != previousCapacity);
+            }
+            for (auto &regionInfo: regionInfos) {
+                SPMR region;
+                if (mapped) {
+                    region = std::make_shared<MR>(regionInfo.baseAddress, source->mappedContent(regionInfo));
+                } else if (lazyCache != nullptr) {
+                    region = std::make_shared<MR>(regionInfo);
+                } else if (auto content = arena.allocate(regionInfo.regionSize); content != nullptr) {
+                    region = std::make_shared<MR>(regionInfo.baseAddress, std::span(content, regionInfo.regionSize));
+                } else {
+                    region = std::make_shared<MR>(regionInfo.baseAddress, regionInfo.regionSize);
+                    instrumentation.add(StageCounter::allocations);
                 }
-                committedRegions->insert(std::pair<PVOID, SPMR>(memoryInfo.BaseAddress,
-                                                                std::make_shared<MR>(memoryInfo.BaseAddress,
-                                                                                    memoryInfo.RegionSize)));
+                committedRegions->insert(std::pair<PVOID, SPMR>(regionInfo.baseAddress, region));
             }
         }
 
-        static inline void readCommittedRegionContent(const HANDLE &hProcess, CPMR region) {
-            SIZE_T bytesRead;
-            int tries = 0;
-            do {
-                ReadProcessMemory(hProcess, region->baseAddress, (LPVOID) region->content.data(),
-                                  region->content.size(), &bytesRead);
-                tries += 1;
-            } while (tries <= 3 and bytesRead != region->content.size());
-            if (bytesRead != region->content.size()) {
-                region->content = std::vector<byte>();
+        static inline void hashRegionPages(MR &region) {
+            auto pages = (region.content.size() + cachePageSize - 1) / cachePageSize;
+            region.pageHashes.resize(pages);
+            for (SIZE_T page = 0; page < pages; page++) {
+                auto offset = page * cachePageSize;
+                region.pageHashes[page] = hashPage(region.content.data() + offset,
+                                                   std::min(cachePageSize, region.content.size() - offset));
             }
         }
 
-        inline void readCommittedRegionContents() {
-            boost::asio::io_service ioService;
-            boost::asio::io_service::work work(ioService);
+        /**
+         * Groups consecutive requests into [begin, end) batches for one readBatch call each.
+         */
+        static inline std::vector<pair<SIZE_T, SIZE_T>> splitIntoReadBatches(const std::vector<MemoryReadRequest> &requests) {
+            std::vector<pair<SIZE_T, SIZE_T>> batches;
+            SIZE_T batchBegin = 0;
+            while (batchBegin < requests.size()) {
+                SIZE_T batchEnd = batchBegin, batchBytes = 0;
+                while (batchEnd < requests.size() && batchEnd - batchBegin < maxRegionsPerBatch &&
+                       (batchEnd == batchBegin || batchBytes + requests[batchEnd].length <= maxBytesPerBatch)) {
+                    batchBytes += requests[batchEnd].length;
+                    batchEnd += 1;
+                }
+                batches.emplace_back(batchBegin, batchEnd);
+                batchBegin = batchEnd;
+            }
+            return batches;
+        }
 
-            // Create a thread pool
-            std::vector<boost::shared_ptr<boost::thread>> threads;
-            for (int i = 0; i < numThreads; ++i) {
-                boost::shared_ptr<boost::thread> thread(new boost::thread(
-                        [ObjectPtr = &ioService] { return ObjectPtr->run(); }
-                ));
-                threads.push_back(thread);
+        inline void readBatchWithRetries(std::span<MemoryReadRequest> requests) const {
+            source->readBatch(requests);
+            SIZE_T bytesRead = 0, retries = 0, failures = 0;
+            for (auto &request: requests) {
+                int tries = 1;
+                while (tries <= 3 and request.bytesRead != request.length) {
+                    request.bytesRead = source->read(request.address, request.buffer, request.length);
+                    tries += 1;
+                }
+                bytesRead += request.bytesRead;
+                retries += tries - 1;
+                failures += request.bytesRead != request.length;
             }
-            for (auto &[_, region]: *committedRegions) {
-                ioService.post([&] { ProcessMemoryReader::readCommittedRegionContent(hProcess, region); });
+            instrumentation.add(StageCounter::bytesRead, bytesRead);
+            instrumentation.add(StageCounter::readRetries, retries);
+            instrumentation.add(StageCounter::readFailures, failures);
+        }
+
+        inline void readRegionContents(const std::vector<SPMR> &regions) {
+            std::vector<MemoryReadRequest> requests;
+            requests.reserve(regions.size());
+            for (auto &region: regions) {
+                requests.push_back({region->baseAddress, (LPVOID) region->content.data(), region->content.size()});
+            }
+            auto batches = splitIntoReadBatches(requests);
+            workerPool->parallelFor(batches.size(), [&](SIZE_T batch) {
+                auto [begin, end] = batches[batch];
+                readBatchWithRetries(std::span(requests).subspan(begin, end - begin));
+                for (auto i = begin; i < end; i++) {
+                    if (requests[i].bytesRead != requests[i].length) {
+                        regions[i]->clear();
+                        continue;
+                    }
+                    hashRegionPages(*regions[i]);
+                }
+            });
+        }
+
+        inline void refreshRegionPages(const std::vector<SPMR> &regions, std::vector<PageRange> &changedPages) {
+            std::vector<MemoryReadRequest> requests;
+            requests.reserve(regions.size());
+            for (auto &region: regions) {
+                requests.push_back({region->baseAddress, nullptr, region->content.size()});
             }
-            ioService.stop();
-            for (auto &thread: threads) {
-                thread->join();
+            auto batches = splitIntoReadBatches(requests);
+            auto batchChanges = std::vector<std::vector<PageRange>>(batches.size());
+            workerPool->parallelFor(batches.size(), [&](SIZE_T batch) {
+                auto [begin, end] = batches[batch];
+                SIZE_T scratchSize = 0;
+                for (auto i = begin; i < end; i++) {
+                    scratchSize += requests[i].length;
+                }
+                auto scratch = std::make_unique_for_overwrite<byte[]>(scratchSize);
+                instrumentation.add(StageCounter::allocations);
+                for (SIZE_T i = begin, offset = 0; i < end; offset += requests[i].length, i++) {
+                    requests[i].buffer = scratch.get() + offset;
+                }
+                readBatchWithRetries(std::span(requests).subspan(begin, end - begin));
+
+                auto &changes = batchChanges[batch];
+                for (auto i = begin; i < end; i++) {
+                    auto &region = *regions[i];
+                    if (requests[i].bytesRead != requests[i].length) {
+                        // Keep the last good copy, the next refresh will try again.
+                        continue;
+                    }
+                    auto fresh = (const byte *) requests[i].buffer;
+                    diffPages(fresh, region.content.size(), region.pageHashes, [&](SIZE_T offset, SIZE_T length) {
+                        std::memcpy(region.content.data() + offset, fresh + offset, length);
+                        appendPageRange(changes, (LPBYTE) region.baseAddress + offset, length);
+                    });
+                }
+            });
+            for (auto &changes: batchChanges) {
+                changedPages.insert(changedPages.end(), changes.begin(), changes.end());
             }
+            std::sort(changedPages.begin(), changedPages.end(), [](const PageRange &a, const PageRange &b) {
+                return a.address < b.address;
+            });
+        }
+
+        /**
+         * Lazy mode counterpart of refreshRegionPages(): fetches the resident blocks of `regions` again.
+         */
+        inline void refreshResidentBlocks(const MMR &regions, CPMMR regionsToReread,
+                                          std::vector<PageRange> &changedPages) {
+            lazyCache->refresh(*workerPool, [&](uint64_t blockAddress) {
+                auto region = regions.upper_bound((PVOID) blockAddress);
+                if (region == regions.begin()) {
+                    return false;
+                }
+                --region;
+                return regionsToReread == nullptr || regionsToReread->contains(region->first);
+            }, changedPages);
+            std::sort(changedPages.begin(), changedPages.end(), [](const PageRange &a, const PageRange &b) {
+                return a.address < b.address;
+            });
         }
     };
-}
\ No newline at end of file
+}
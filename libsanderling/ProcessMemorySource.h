@@ -0,0 +1,76 @@
+//
+// Created by allan on 2024/4/6.
+//
+
+#pragma once
+
+#include "common.h"
+
+namespace eve {
+
+    struct MemoryRegionInfo {
+        PVOID baseAddress = nullptr;
+        SIZE_T regionSize = 0;
+    };
+
+    struct MemoryReadRequest {
+        PVOID address = nullptr;
+        LPVOID buffer = nullptr;
+        SIZE_T length = 0;
+        SIZE_T bytesRead = 0;
+    };
+
+    /**
+     * Where the bytes of a foreign address space come from. ProcessMemoryReader only talks to this interface,
+     * so the OS specific parts (Win32 handles, /proc, ...) stay in the backends.
+     */
+    class ProcessMemorySource {
+    public:
+        virtual ~ProcessMemorySource() = default;
+
+        [[nodiscard]] virtual bool isOpen() const = 0;
+
+        [[nodiscard]] virtual DWORD processId() const = 0;
+
+        /**
+         * Tells apart processes that got the same id, 0 when the backend does not know it. Only compared for
+         * equality, the unit depends on the OS.
+         */
+        [[nodiscard]] virtual uint64_t processStartTime() const {
+            return 0;
+        }
+
+        /**
+         * Committed, readable regions sorted by base address.
+         */
+        [[nodiscard]] virtual std::vector<MemoryRegionInfo> enumerateReadableRegions() const = 0;
+
+        /**
+         * Reads up to `length` bytes, returns the number of bytes actually read.
+         */
+        virtual SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const = 0;
+
+        /**
+         * Fills `bytesRead` of every request. Backends with vectored reads override this to batch syscalls.
+         */
+        virtual void readBatch(std::span<MemoryReadRequest> requests) const {
+            for (auto &request: requests) {
+                request.bytesRead = read(request.address, request.buffer, request.length);
+            }
+        }
+
+        /**
+         * Sources that already hold the whole address space in memory (snapshots) hand out their bytes directly
+         * instead of being copied by read(). The memory stays valid for the lifetime of the source.
+         */
+        [[nodiscard]] virtual bool isMapped() const {
+            return false;
+        }
+
+        [[nodiscard]] virtual std::span<byte> mappedContent(const MemoryRegionInfo &/*region*/) const {
+            return {};
+        }
+    };
+
+    typedef std::unique_ptr<ProcessMemorySource> PMS;
+}
@@ -0,0 +1,78 @@
+//
+// Created by allan on 2024/4/19.
+//
+
+#pragma once
+
+#include "common.h"
+
+namespace eve {
+
+    /**
+     * [offset, offset + length) of a string pool.
+     */
+    struct StringRef {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    enum class PyValueKind : uint8_t {
+        unknown,
+        none,
+        boolean,
+        integer,
+        floating,
+        string,
+        list,
+        tuple,
+        set,
+        dict,
+        color,
+        bunch,
+    };
+
+    /**
+     * A decoded Python object, see PythonMemoryReader::decodePythonValue(). Which members are set depends on
+     * `kind`, everything variable sized lives in the PyValueBuffer it was decoded into.
+     */
+    struct PyValue {
+        PyValueKind kind = PyValueKind::unknown;
+        uint32_t typeId = 0;
+        PVOID address = nullptr;
+        // boolean, integer. A `long` that does not fit keeps its approximate value in `floating` only.
+        int64_t integer = 0;
+        // floating, integer
+        double floating = 0;
+        // string: str and unicode, the latter as UTF-8.
+        StringRef text;
+        // list, tuple, set: item addresses, dict and bunch: key and value address pairs, in PyValueBuffer::items.
+        uint32_t firstItem = 0;
+        uint32_t itemCount = 0;
+        // color: r, g, b, a
+        std::array<float, 4> rgba = {};
+    };
+
+    struct PyValueBuffer {
+        std::string stringPool;
+        std::vector<PVOID> items;
+
+        [[nodiscard]] inline std::string_view string(StringRef ref) const {
+            return std::string_view(stringPool).substr(ref.offset, ref.length);
+        }
+
+        [[nodiscard]] inline std::span<const PVOID> itemsOf(const PyValue &value) const {
+            return std::span(items).subspan(value.firstItem, value.itemCount);
+        }
+
+        inline StringRef appendString(std::string_view chars) {
+            auto ref = StringRef{(uint32_t) stringPool.size(), (uint32_t) chars.size()};
+            stringPool.append(chars);
+            return ref;
+        }
+
+        inline void clear() {
+            stringPool.clear();
+            items.clear();
+        }
+    };
+}
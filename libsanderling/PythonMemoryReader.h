@@ -4,6 +4,11 @@
 #pragma once
 
 #include "ProcessMemoryReader.h"
+#include "ScanKernels.h"
+#include "TypeNameTable.h"
+#include "TypeNameCache.h"
+#include "PyValue.h"
+#include "DiscoveryCache.h"
 
 namespace eve {
 
@@ -46,9 +51,56 @@ namespace eve {
             double ob_fval;
         };
 
+        // Layouts of the 64 bit Windows build EVE ships: a C long is 4 bytes, Py_UNICODE is UTF-16.
         struct PyIntObject {
             PyObject ob_base;
-            long ob_ival;
+            int32_t ob_ival;
+        };
+
+        struct PyLongObject {
+            // The sign of ob_size is the sign of the number, its magnitude the number of digits.
+            int64_t ob_refcnt;
+            PyTypeObject *ob_type;
+            int64_t ob_size;
+            uint32_t ob_digit[1];
+        };
+
+        static constexpr SIZE_T longDigitBits = 30;
+
+        struct PyUnicodeObject {
+            PyObject ob_base;
+            uint64_t length;
+            char16_t *str;
+            int64_t hash;
+            PyObject *defenc;
+        };
+
+        struct PyListObject {
+            PyVarObject ob_base;
+            PyObject **ob_item;
+            uint64_t allocated;
+        };
+
+        struct PyTupleObject {
+            PyVarObject ob_base;
+            PyObject *ob_item[1];
+        };
+
+        struct PySetEntry {
+            int64_t hash;
+            PyObject *key;
+        };
+
+        struct PySetObject {
+            PyObject ob_base;
+            uint64_t fill;
+            uint64_t used;
+            uint64_t mask;
+            PySetEntry *table;
+            PVOID lookup;
+            PySetEntry smalltable[8];
+            int64_t hash;
+            PVOID weakreflist;
         };
 
         struct PyDictEntry {
@@ -71,107 +123,241 @@ namespace eve {
     }
 
 
+    /**
+     * One dict entry picked by PythonMemoryReader::readPythonDict(): the id the key was mapped to and the address
+     * of the value object.
+     */
+    struct DictEntry {
+        uint32_t keyId;
+        PVOID value;
+    };
+
+    /**
+     * Key object address -> key id, -1 for keys that are not of interest. Python interns attribute names, so the
+     * `__dict__`s of all objects share a few hundred key objects and nearly every lookup hits. Shared by threads.
+     */
+    class DictKeyCache {
+    public:
+        static constexpr SIZE_T maxKeyLength = 63;
+
+        [[nodiscard]] inline std::optional<int> find(PVOID keyObjectAddress) const {
+            std::shared_lock lock(mutex);
+            auto id = ids.find(keyObjectAddress);
+            if (id == ids.end()) {
+                return std::nullopt;
+            }
+            return id->second;
+        }
+
+        inline void insert(PVOID keyObjectAddress, int id) {
+            std::unique_lock lock(mutex);
+            ids.emplace(keyObjectAddress, id);
+        }
+
+        /**
+         * Needed once key objects may have been freed, i.e. after the region layout changed.
+         */
+        inline void clear() {
+            std::unique_lock lock(mutex);
+            ids.clear();
+        }
+
+    private:
+        std::unordered_map<PVOID, int> ids;
+        mutable std::shared_mutex mutex;
+    };
+
+    class PythonMemoryReader;
+
+    /**
+     * Decodes the object at `address` into `value`, `value.kind` is left as unknown when it cannot.
+     */
+    typedef bool (*PyValueDecoder)(PythonMemoryReader &reader, PVOID address, PyValue &value, PyValueBuffer &buffer);
+
     class PythonMemoryReader : public ProcessMemoryReader {
     public:
-        explicit PythonMemoryReader(DWORD processId, uint8_t numThreads = 4) : ProcessMemoryReader(processId,
-                                                                                                   numThreads) {
+        explicit PythonMemoryReader(DWORD processId, uint8_t numThreads = 4) : PythonMemoryReader(
+                openProcessMemorySource(processId), numThreads) {}
+
+        explicit PythonMemoryReader(PMS source, uint8_t numThreads = 4, SPWP workerPool = nullptr,
+                                    CacheOptions cacheOptions = {}) :
+                ProcessMemoryReader(std::move(source), numThreads, std::move(workerPool), cacheOptions) {
+            // Builtin type ids are their index in builtinTypeNames, valueDecoders relies on it.
+            for (auto name: builtinTypeNames) {
+                typeNameCache.intern(name);
+            }
+            valueDecoders.assign(builtinValueDecoders.begin(), builtinValueDecoders.end());
+            const char *scanKernel = nullptr;
+            kernels::selectSelfReferenceScan(&scanKernel);
+            LOG_S(INFO) << std::format("using {} type scan kernel.", scanKernel);
+            loadDiscovery();
+            if (restorePythonTypes()) {
+                LOG_S(INFO) << "python types restored from the discovery cache.";
+                return;
+            }
             EnumerateCandidatesForPythonTypes();
             LOG_S(INFO) << std::format("{} python type types found.", pythonTypes->size());
             EnumeratePythonBuiltinTypeAddresses();
+            discovery.addresses["type"] = std::vector<PVOID>(pythonTypes->begin(), pythonTypes->end());
+            discovery.addresses["builtin"] = std::vector<PVOID>(builtinTypeAddresses.begin(),
+                                                                builtinTypeAddresses.end());
+            discovery.fingerprint = discoveryFingerprint(discovery.addresses["type"]);
+            saveDiscovery();
         }
 
         ~PythonMemoryReader() = default;
 
+        /**
+         * ProcessMemoryReader::refreshCache(), and re-filters the builtin type regions when the region layout changed.
+         * Type objects may have been freed with their regions, the type name cache starts over from the builtins.
+         */
+        inline CacheDiff refreshCache(CPMMR regionsToReread = nullptr) {
+            auto diff = ProcessMemoryReader::refreshCache(regionsToReread);
+            if (diff.hasLayoutChanges()) {
+                typeNameCache.clear();
+                insertBuiltinTypeNames();
+            }
+            if (diff.hasLayoutChanges() && !pythonBuiltinTypesMapping.empty()) {
+                builtinTypeRegions = nullptr;
+                setBuiltinTypeRegions(pythonBuiltinTypesMapping.begin()->first);
+            }
+            for (auto typeAddress: *pythonTypes) {
+                if (!isCachedAddress(typeAddress)) {
+                    LOG_S(WARNING) << std::format("python type type @ 0x{:X} is gone.", (uint64_t) typeAddress);
+                }
+            }
+            return diff;
+        }
+
         template<class PyObject> friend class ForeignPyObject;
 
-        inline bool isPyTypeObject(PVOID nativeObjectAddress) const {
-            auto *pyObjectPtr = (py27::PyObject *) nativeObjectAddress;
-            return pythonTypes->contains(pyObjectPtr->ob_type);
+        inline bool isPyTypeObject(PVOID objectAddress) const {
+            auto pyObject = readCachedValue<py27::PyObject>(objectAddress);
+            return pyObject.has_value() && pythonTypes->contains(pyObject->ob_type);
         }
 
-        inline PSTR getPyObjectTypeName(PVOID foreignObjectAddress) const {
-            if (foreignObjectAddress == nullptr) {
-                return nullptr;
-            }
-            auto pyObjectPtr = readMemory<py27::PyObject>(foreignObjectAddress);
-            auto ob_type = pyObjectPtr->ob_type;
-            if (pythonBuiltinTypesMapping.contains(ob_type)) {
-                return make_unique<STR>(pythonBuiltinTypesMapping.at(ob_type));
+        /**
+         * Interned type id of the object at `objectAddress`, TypeNameCache::invalidId if it has no readable type.
+         */
+        inline uint32_t getPyObjectTypeId(PVOID objectAddress) {
+            auto pyObject = readCachedValue<py27::PyObject>(objectAddress);
+            if (!pyObject.has_value()) {
+                return TypeNameCache::invalidId;
             }
-            if (isPyTypeObject(foreignObjectAddress)) {
-                auto pyTypeObject = (py27::PyTypeObject *) foreignObjectAddress;
-                return readCachedNullTerminatedAsciiString(pyTypeObject->tp_name, 255);
-            }
-            return nullptr;
+            return getTypeObjectId(pyObject->ob_type);
+        }
+
+        /**
+         * tp_name of the type of the object at `objectAddress`, empty if it has no readable type. Owned by the
+         * type name cache, valid for the lifetime of the reader.
+         */
+        inline std::string_view getPyObjectTypeName(PVOID objectAddress) {
+            return typeNameCache.name(getPyObjectTypeId(objectAddress));
+        }
+
+        /**
+         * tp_name of the type object at `typeObjectAddress`, like getPyObjectTypeName().
+         */
+        inline std::string_view getPythonTypeObjectName(PVOID typeObjectAddress) {
+            return typeNameCache.name(getTypeObjectId(typeObjectAddress));
         }
 
-        inline PSTR getPythonTypeObjectName(PVOID nativeObjectAddress) const {
-            if (nativeObjectAddress == nullptr) {
-                return nullptr;
+        /**
+         * Interned id of the type object at `typeObjectAddress`. Looked up without locking, the tp_name is only
+         * read the first time a type is seen. Only types of the confirmed `type` type are cached, invalidId until
+         * the builtin types are found.
+         */
+        inline uint32_t getTypeObjectId(PVOID typeObjectAddress) {
+            auto id = typeNameCache.find(typeObjectAddress);
+            if (id != TypeNameCache::invalidId) {
+                return id;
             }
-            auto *pyObjectPtr = (py27::PyObject *) nativeObjectAddress;
-            auto ob_type = pyObjectPtr->ob_type;
-            if (pythonBuiltinTypesMapping.contains(ob_type)) {
-                return make_unique<STR>(pythonBuiltinTypesMapping.at(ob_type));
+            auto typeObject = readCachedValue<py27::PyTypeObject>(typeObjectAddress);
+            if (!typeObject.has_value() || confirmedTypeType == nullptr ||
+                typeObject->ob_base.ob_type != confirmedTypeType) {
+                return TypeNameCache::invalidId;
             }
-            if (isPyTypeObject(nativeObjectAddress)) {
-                auto pyTypeObject = (py27::PyTypeObject *) nativeObjectAddress;
-                return readCachedNullTerminatedAsciiString(pyTypeObject->tp_name, 255);
+            auto typeName = readCachedNullTerminatedAsciiStringView(typeObject->tp_name, 255);
+            if (typeName.empty()) {
+                return TypeNameCache::invalidId;
             }
-            return nullptr;
+            return typeNameCache.insert(typeObjectAddress, typeName);
+        }
+
+        [[nodiscard]] inline const TypeNameCache &getTypeNameCache() const {
+            return typeNameCache;
         }
 
         inline PUSP EnumerateCandidatesForPythonObjects( // NOLINT(*-no-recursion)
                 const function<bool(uint64_t *)> &ob_type_filter,
-                const function<bool(PSTR const&)> &tp_name_filter
+                const function<bool(std::string_view)> &tp_name_filter
         ) {
             return std::move(EnumerateCandidatesForPythonObjects(ob_type_filter, tp_name_filter, committedRegions));
         }
 
-        inline PUSP EnumerateCandidatesForPythonObjects( // NOLINT(*-no-recursion)
+        inline PUSP EnumerateCandidatesForPythonObjects(
                 const function<bool(uint64_t *)> &ob_type_filter,
-                const function<bool(PSTR const&)> &tp_name_filter,
+                const function<bool(std::string_view)> &tp_name_filter,
+                CPMMR filteredRegions
+        ) {
+            auto candidates = EnumerateCandidatesForPythonObjectsByTypeName(
+                    ob_type_filter,
+                    [&tp_name_filter](std::string_view tp_name) {
+                        return tp_name_filter(tp_name) ? 0 : -1;
+                    },
+                    1,
+                    filteredRegions
+            );
+            return make_unique<USP>(std::move(candidates[0]));
+        }
+
+        /**
+         * Single pass over `filteredRegions` for many type names: `tp_name_bucket` maps a tp_name to the index of
+         * the result set its object goes to, or -1 to drop it.
+         */
+        inline std::vector<USP> EnumerateCandidatesForPythonObjectsByTypeName( // NOLINT(*-no-recursion)
+                const function<bool(uint64_t *)> &ob_type_filter,
+                const function<int(std::string_view)> &tp_name_bucket,
+                SIZE_T bucketCount,
                 CPMMR filteredRegions
         ) {
             if (filteredRegions == nullptr || filteredRegions->empty()) {
-                return std::move(EnumerateCandidatesForPythonObjects(ob_type_filter, tp_name_filter));
+                return EnumerateCandidatesForPythonObjectsByTypeName(ob_type_filter, tp_name_bucket, bucketCount,
+                                                                     committedRegions);
             }
 
-            boost::asio::io_service ioService;
-            boost::asio::io_service::work work(ioService);
-
-            // Create a thread pool
-            std::vector<boost::shared_ptr<boost::thread>> threads;
-            for (int i = 0; i < numThreads; ++i) {
-                boost::shared_ptr<boost::thread> thread(new boost::thread(
-                        [ObjectPtr = &ioService] { return ObjectPtr->run(); }
-                ));
-                threads.push_back(thread);
-            }
-            auto regionList = new std::unordered_set<PVOID> *[filteredRegions->size()];
-            for (auto [it, i] = std::tuple{filteredRegions->begin(), 0}; it != filteredRegions->end(); it++, i++) {
-                auto &region = it->second;
-                ioService.post([=, &region, &regionList, this] {
-                    auto candidates = EnumerateCandidatesForPythonObjectsInMemoryRegion(region, ob_type_filter,
-                                                                                        tp_name_filter);
-                    regionList[i] = candidates;
-                });
-            }
-            ioService.stop();
-            for (auto &thread: threads) {
-                thread->join();
-            }
-            auto allCandidates = std::make_unique<USP>();
-            for (auto i = 0; i < filteredRegions->size(); i++) {
-                auto regionCandidates = regionList[i];
-                if (regionCandidates == nullptr || regionCandidates->empty()) {
-                    continue;
+            instrumentation.add(StageCounter::regionsVisited, filteredRegions->size());
+            auto chunks = splitIntoScanChunks(*filteredRegions, objectScanWindowWords);
+            auto chunkList = std::vector<std::vector<BucketedCandidate>>(chunks.size());
+            workerPool->parallelFor(chunks.size(), [&](SIZE_T i) {
+                EnumerateCandidatesForPythonObjectsInScanChunk(chunks[i], ob_type_filter, tp_name_bucket,
+                                                               chunkList[i]);
+            });
+            auto allCandidates = std::vector<USP>(bucketCount);
+            for (auto &chunkCandidates: chunkList) {
+                for (auto &[bucket, address]: chunkCandidates) {
+                    allCandidates[bucket].insert(address);
                 }
-                allCandidates->insert_range(*regionCandidates);
             }
             return allCandidates;
         }
 
+        template<SIZE_T N>
+        inline std::vector<USP> EnumerateCandidatesForPythonObjectsByTypeName(
+                const function<bool(uint64_t *)> &ob_type_filter,
+                const TypeNameTable<N> &typeNames,
+                CPMMR filteredRegions
+        ) {
+            return EnumerateCandidatesForPythonObjectsByTypeName(
+                    ob_type_filter,
+                    [&typeNames](std::string_view tp_name) {
+                        return typeNames.find(tp_name);
+                    },
+                    N,
+                    filteredRegions
+            );
+        }
+
         template<class T>
         auto readPythonObject(PVOID objectAddress) {
 //            auto pyObject = readCachedMemory<py27::PyObject>(objectAddress);
@@ -189,179 +375,760 @@ namespace eve {
 
         }
 
-        template<class KT, class VT>
-        inline std::map<KT, VT> *readPythonDict(PVOID dictObjectAddress) {
-            auto *dictObject = (py27::PyDictObject *) dictObjectAddress;
-            auto dict = new std::map<KT, VT>();
+        /**
+         * Reads the entries of the dict at `dictObjectAddress` whose `str` key is accepted by `keyId`, appending
+         * {key id, value address} to `entries`. The slot table is fetched in one piece, small dicts come with the
+         * dict object itself. Key objects are resolved once and remembered in `keyCache`.
+         *
+         * Returns false when the dict is not cached or looks like garbage, `entries` is left untouched then.
+         */
+        inline bool readPythonDict(PVOID dictObjectAddress, const function<int(std::string_view)> &keyId,
+                                   DictKeyCache &keyCache, std::vector<DictEntry> &entries) const {
+            auto slots = readPythonDictSlots(dictObjectAddress);
+            if (!slots.has_value()) {
+                return false;
+            }
+            for (auto &slot: *slots) {
+                // Unused slots have no key, deleted ones keep a dummy key but no value.
+                if (slot.me_key == nullptr || slot.me_value == nullptr) {
+                    continue;
+                }
+                auto id = keyCache.find(slot.me_key);
+                if (!id.has_value()) {
+                    id = keyId(readPythonStrView(slot.me_key, DictKeyCache::maxKeyLength));
+                    keyCache.insert(slot.me_key, *id);
+                }
+                if (*id < 0) {
+                    continue;
+                }
+                entries.push_back({(uint32_t) *id, slot.me_value});
+            }
+            return true;
+        }
 
+        /**
+         * Slot table of the dict at `dictObjectAddress`, including unused and deleted slots. Valid until the calling
+         * thread reads the next dict.
+         */
+        inline std::optional<std::span<const py27::PyDictEntry>> readPythonDictSlots(PVOID dictObjectAddress) const {
+            auto dictObject = readCachedValue<py27::PyDictObject>(dictObjectAddress);
+            if (!dictObject.has_value()) {
+                return std::nullopt;
+            }
             auto numberOfSlots = (SIZE_T) dictObject->ma_mask + 1;
-            if (numberOfSlots < 0 || 10000 < numberOfSlots) {
+            if (!std::has_single_bit(numberOfSlots) || maxDictSlots < numberOfSlots ||
+                numberOfSlots <= dictObject->ma_used) {
                 //  Avoid stalling the whole reading process when a single dictionary contains garbage.
-                return nullptr;
+                return std::nullopt;
             }
-            auto slotsMemory = readCachedMemory<py27::PyDictEntry>(dictObject->ma_table, numberOfSlots);
-            if (slotsMemory == nullptr) {
-                return nullptr;
+            // Copied out, the cached bytes are not guaranteed to be aligned for PyDictEntry.
+            slotBuffer.resize(numberOfSlots);
+            auto smallTableAddress = (LPBYTE) dictObjectAddress + offsetof(py27::PyDictObject, ma_smalltable);
+            if ((LPBYTE) dictObject->ma_table == smallTableAddress && numberOfSlots <= std::size(dictObject->ma_smalltable)) {
+                std::copy_n(dictObject->ma_smalltable, numberOfSlots, slotBuffer.begin());
+                return std::span<const py27::PyDictEntry>(slotBuffer);
             }
-            for (auto slotIndex = 0; slotIndex < numberOfSlots; ++slotIndex) {
-                auto slot = slotsMemory[slotIndex];
-                if (slot.me_key == nullptr) {
-                    continue;
-                }
-                auto key = (KT) slot.me_key;
-                auto value = (VT) slot.me_value;
-                dict->insert(std::pair<KT, VT>(key, value));
+            auto slotBytes = readCachedSpan(dictObject->ma_table, numberOfSlots * sizeof(py27::PyDictEntry));
+            if (slotBytes.size() != numberOfSlots * sizeof(py27::PyDictEntry)) {
+                return std::nullopt;
+            }
+            std::memcpy(slotBuffer.data(), slotBytes.data(), slotBytes.size());
+            return std::span<const py27::PyDictEntry>(slotBuffer);
+        }
+
+        template<SIZE_T N>
+        inline bool readPythonDict(PVOID dictObjectAddress, const TypeNameTable<N> &keys, DictKeyCache &keyCache,
+                                   std::vector<DictEntry> &entries) const {
+            return readPythonDict(dictObjectAddress, [&keys](std::string_view key) {
+                return keys.find(key);
+            }, keyCache, entries);
+        }
+
+        /**
+         * Content of the `str` object at `strObjectAddress`, empty if it is not a cached `str` or longer than
+         * `maxLength`. Views the cache, see readCachedSpan().
+         */
+        inline std::string_view readPythonStrView(PVOID strObjectAddress, SIZE_T maxLength = 255) const {
+            auto strObject = readCachedValue<py27::PyVarObject>(strObjectAddress);
+            if (!strObject.has_value() || !isBuiltinType(strObject->ob_type, builtinStr) ||
+                maxLength < strObject->ob_size) {
+                return {};
+            }
+            auto chars = readCachedSpan((LPBYTE) strObjectAddress + offsetof(py27::PyStrObject, ob_sval),
+                                        strObject->ob_size);
+            if (chars.size() != strObject->ob_size) {
+                return {};
+            }
+            return {(const char *) chars.data(), chars.size()};
+        }
+
+        /**
+         * Value of an `int`, `bool` or `float` object, std::nullopt for any other object.
+         */
+        inline std::optional<double> readPythonNumber(PVOID objectAddress) const {
+            auto object = readCachedValue<py27::PyFloatObject>(objectAddress);
+            if (!object.has_value()) {
+                return std::nullopt;
+            }
+            auto ob_type = object->ob_base.ob_type;
+            if (isBuiltinType(ob_type, builtinFloat)) {
+                return object->ob_fval;
+            }
+            if (isBuiltinType(ob_type, builtinInt) || isBuiltinType(ob_type, builtinBool)) {
+                auto intObject = readCachedValue<py27::PyIntObject>(objectAddress);
+                return intObject.has_value() ? std::optional<double>(intObject->ob_ival) : std::nullopt;
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * Decodes the object at `address` into `value`, variable sized parts go to `buffer`. The decoder is picked
+         * by the interned type id in a table, builtin types additionally have to match the type object found at
+         * startup. Returns false, with `value.kind` unknown, for types without a decoder.
+         */
+        inline bool decodePythonValue(PVOID address, PyValue &value, PyValueBuffer &buffer) {
+            value = PyValue{};
+            value.address = address;
+            auto object = readCachedValue<py27::PyObject>(address);
+            if (!object.has_value()) {
+                return false;
+            }
+            auto typeId = getTypeObjectId(object->ob_type);
+            value.typeId = typeId;
+            if (typeId >= valueDecoders.size() || valueDecoders[typeId] == nullptr ||
+                (typeId < builtinTypeNames.size() && builtinTypeAddresses[typeId] != object->ob_type)) {
+                return false;
+            }
+            if (!valueDecoders[typeId](*this, address, value, buffer)) {
+                value.kind = PyValueKind::unknown;
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Makes decodePythonValue() decode objects whose type is named `typeName` with `decoder`. Must not run
+         * concurrently with decoding.
+         */
+        inline void registerValueDecoder(std::string_view typeName, PyValueDecoder decoder) {
+            auto typeId = typeNameCache.intern(typeName);
+            if (typeId == TypeNameCache::invalidId) {
+                return;
+            }
+            if (valueDecoders.size() <= typeId) {
+                valueDecoders.resize(typeId + 1);
+            }
+            valueDecoders[typeId] = decoder;
+        }
+
+        /**
+         * Content of a `str` or `unicode` object, the latter converted to UTF-8. Valid until the calling thread reads
+         * the next text.
+         */
+        inline std::string_view readPythonTextView(PVOID objectAddress, SIZE_T maxLength = 4096) {
+            static thread_local PyValueBuffer textBuffer;
+            textBuffer.clear();
+            auto object = readCachedValue<py27::PyObject>(objectAddress);
+            if (!object.has_value()) {
+                return {};
+            }
+            if (isBuiltinType(object->ob_type, builtinStr)) {
+                return readPythonStrView(objectAddress, maxLength);
+            }
+            PyValue value;
+            if (!isBuiltinType(object->ob_type, builtinUnicode) ||
+                !decodeUnicode(*this, objectAddress, value, textBuffer) || maxLength < value.text.length) {
+                return {};
+            }
+            return textBuffer.string(value.text);
+        }
+
+        /**
+         * Item addresses of the `list` at `listObjectAddress`, appended to `items`. False if it is not a cached
+         * list or has more than `maxItems` items.
+         */
+        inline bool readPythonList(PVOID listObjectAddress, std::vector<PVOID> &items, SIZE_T maxItems = 4096) const {
+            auto listObject = readCachedValue<py27::PyListObject>(listObjectAddress);
+            if (!listObject.has_value() || !isBuiltinType(listObject->ob_base.ob_type, builtinList) ||
+                maxItems < listObject->ob_base.ob_size) {
+                return false;
+            }
+            auto itemBytes = readCachedSpan(listObject->ob_item, listObject->ob_base.ob_size * sizeof(PVOID));
+            if (itemBytes.size() != listObject->ob_base.ob_size * sizeof(PVOID)) {
+                return false;
+            }
+            auto offset = items.size();
+            items.resize(offset + listObject->ob_base.ob_size);
+            std::memcpy(items.data() + offset, itemBytes.data(), itemBytes.size());
+            return true;
+        }
+
+        /**
+         * Change detection hash over a dict object and its slot table, as found in the cache. Unreadable dicts
+         * hash like empty memory.
+         */
+        [[nodiscard]] inline uint64_t hashPythonDict(PVOID dictObjectAddress) const {
+            auto dictBytes = readCachedSpan(dictObjectAddress, sizeof(py27::PyDictObject));
+            auto hash = hashPage(dictBytes.data(), dictBytes.size());
+            auto dictObject = readCachedValue<py27::PyDictObject>(dictObjectAddress);
+            auto smallTableAddress = (LPBYTE) dictObjectAddress + offsetof(py27::PyDictObject, ma_smalltable);
+            if (!dictObject.has_value() || (LPBYTE) dictObject->ma_table == smallTableAddress ||
+                maxDictSlots <= dictObject->ma_mask) {
+                return hash;
+            }
+            auto slotBytes = readCachedSpan(dictObject->ma_table, (dictObject->ma_mask + 1) * sizeof(py27::PyDictEntry));
+            return hash ^ std::rotl(hashPage(slotBytes.data(), slotBytes.size()), 32);
+        }
+
+        /**
+         * Change detection hash over a list object and its items, like hashPythonDict().
+         */
+        [[nodiscard]] inline uint64_t hashPythonList(PVOID listObjectAddress) const {
+            auto listBytes = readCachedSpan(listObjectAddress, sizeof(py27::PyListObject));
+            auto hash = hashPage(listBytes.data(), listBytes.size());
+            auto listObject = readCachedValue<py27::PyListObject>(listObjectAddress);
+            if (!listObject.has_value() || maxDictSlots < listObject->ob_base.ob_size) {
+                return hash;
+            }
+            auto itemBytes = readCachedSpan(listObject->ob_item, listObject->ob_base.ob_size * sizeof(PVOID));
+            return hash ^ std::rotl(hashPage(itemBytes.data(), itemBytes.size()), 32);
+        }
+
+        /**
+         * Change detection hash over the type and value of a `float`, `int`, `bool`, `str` or `unicode` object,
+         * without its reference count. CPython hands freed objects of these types out again from free lists, so
+         * a dict slot pointing to the same address does not mean it holds the same value. Other objects hash by
+         * their type only, texts longer than `maxLength` by their length.
+         */
+        [[nodiscard]] inline uint64_t hashPythonValue(PVOID objectAddress, SIZE_T maxLength = 4096) const {
+            auto object = readCachedValue<py27::PyVarObject>(objectAddress);
+            if (!object.has_value()) {
+                return 0;
             }
-            for (uint64_t i = 0; i < dictObject->ma_used; i++) {
-                auto entry = dictObject->ma_table[i];
-                auto key = (KT) entry.me_key;
-                auto value = (VT) entry.me_value;
-                dict->insert(std::pair<KT, VT>(key, value));
+            auto hash = hashRound(0, (uint64_t) object->ob_type);
+            std::span<const byte> payload;
+            if (isBuiltinType(object->ob_type, builtinFloat)) {
+                payload = readCachedSpan((LPBYTE) objectAddress + offsetof(py27::PyFloatObject, ob_fval),
+                                         sizeof(double));
+            } else if (isBuiltinType(object->ob_type, builtinInt) || isBuiltinType(object->ob_type, builtinBool)) {
+                payload = readCachedSpan((LPBYTE) objectAddress + offsetof(py27::PyIntObject, ob_ival),
+                                         sizeof(int32_t));
+            } else if (isBuiltinType(object->ob_type, builtinStr)) {
+                hash = hashRound(hash, object->ob_size);
+                if (object->ob_size <= maxLength) {
+                    payload = readCachedSpan((LPBYTE) objectAddress + offsetof(py27::PyStrObject, ob_sval),
+                                             object->ob_size);
+                }
+            } else if (isBuiltinType(object->ob_type, builtinUnicode)) {
+                auto unicodeObject = readCachedValue<py27::PyUnicodeObject>(objectAddress);
+                if (unicodeObject.has_value()) {
+                    hash = hashRound(hashRound(hash, unicodeObject->length), (uint64_t) unicodeObject->str);
+                    if (unicodeObject->length <= maxLength) {
+                        payload = readCachedSpan(unicodeObject->str, unicodeObject->length * sizeof(char16_t));
+                    }
+                }
             }
-            return dict;
+            return fmix64(hash) ^ hashPage(payload.data(), payload.size());
+        }
+
+        [[nodiscard]] inline bool isBuiltinType(const void *ob_type, std::string_view name) const {
+            auto builtinIndex = builtinTypeNames.find(name);
+            return builtinIndex >= 0 && isBuiltinType(ob_type, (SIZE_T) builtinIndex);
+        }
+
+        /**
+         * Like isBuiltinType(ob_type, name), with the index in builtinTypeNames resolved beforehand, see builtinStr.
+         */
+        [[nodiscard]] inline bool isBuiltinType(const void *ob_type, SIZE_T builtinIndex) const {
+            return ob_type != nullptr && builtinTypeAddresses[builtinIndex] == ob_type;
         }
 
     protected:
+        // Bigger dicts are taken for garbage.
+        static constexpr SIZE_T maxDictSlots = 16384;
         PMMR builtinTypeRegions = nullptr;
         PUSP pythonTypes = nullptr;
         std::map<PVOID, string> pythonBuiltinTypesMapping = {};
-        std::map<PVOID, string> pythonUserDefinedTypesMapping = {};
-        std::shared_mutex pythonUserDefinedTypesMappingMutex;
-        static constexpr std::array builtinTypeNames = {"str"sv, "float"sv, "dict"sv, "int"sv, "unicode"sv, "long"sv,
-                                                        "list"sv, "tuple"sv, "bool"sv, "set"sv, "NoneType"sv};
+        TypeNameCache typeNameCache;
+        static constexpr TypeNameTable builtinTypeNames{std::array{"str"sv, "float"sv, "dict"sv, "int"sv, "unicode"sv,
+                                                                   "long"sv, "list"sv, "tuple"sv, "bool"sv, "set"sv,
+                                                                   "NoneType"sv}};
+        // Indices in builtinTypeNames of the types the readers check objects against, resolved at compile time.
+        static constexpr SIZE_T builtinStr = builtinTypeNames.find("str"sv);
+        static constexpr SIZE_T builtinFloat = builtinTypeNames.find("float"sv);
+        static constexpr SIZE_T builtinInt = builtinTypeNames.find("int"sv);
+        static constexpr SIZE_T builtinUnicode = builtinTypeNames.find("unicode"sv);
+        static constexpr SIZE_T builtinList = builtinTypeNames.find("list"sv);
+        static constexpr SIZE_T builtinBool = builtinTypeNames.find("bool"sv);
+        // Indexed like builtinTypeNames.
+        std::array<PVOID, builtinTypeNames.size()> builtinTypeAddresses = {};
+        // The one of pythonTypes the builtin types are instances of, nullptr until they are found.
+        PVOID confirmedTypeType = nullptr;
+        // What this reader discovered or restored, and the record found in the discovery cache when attaching.
+        DiscoveryRecord discovery;
+        std::optional<DiscoveryRecord> cachedDiscovery;
 
-    private:
-        [[nodiscard]] inline std::unordered_set<PVOID> *
-        EnumerateCandidatesForPythonTypesInMemoryRegion(CPMR region) const {
-            if (region == nullptr || region->content.empty()) {
-                // LOG_S(WARNING) << "No committed regions loaded.";
-                return nullptr;
-            }
-            auto memoryRegionContentAsULongArray = (uint64_t *) region->content.data();
-            auto baseAddress = (uint64_t *) region->baseAddress;
-            auto longLength = region->content.size() / 8;
-            auto candidates = new std::unordered_set<PVOID>();
-
-            for (uint64_t candidateAddressIndex = 0; candidateAddressIndex < longLength - 4; candidateAddressIndex++) {
-                auto candidateAddressInProcess = baseAddress + candidateAddressIndex;
-                auto candidate_ob_type = (uint64_t *) memoryRegionContentAsULongArray[candidateAddressIndex + 1];
-                if (candidate_ob_type != candidateAddressInProcess) {
+        inline void loadDiscovery() {
+            discovery.processId = source->processId();
+            discovery.processStartTime = source->processStartTime();
+            if (cacheOptions.discoveryCacheDirectory.empty()) {
+                return;
+            }
+            cachedDiscovery = DiscoveryCache::load(cacheOptions.discoveryCacheDirectory, discovery.processId,
+                                                   discovery.processStartTime);
+        }
+
+        /**
+         * Writes `discovery` unless it is what the cache already holds.
+         */
+        inline void saveDiscovery() const {
+            if (cacheOptions.discoveryCacheDirectory.empty() ||
+                (cachedDiscovery.has_value() && cachedDiscovery->fingerprint == discovery.fingerprint &&
+                 cachedDiscovery->addresses == discovery.addresses)) {
+                return;
+            }
+            DiscoveryCache::save(cacheOptions.discoveryCacheDirectory, discovery);
+        }
+
+        /**
+         * Base and size of the regions holding `typeTypes`, hashed. Changes when the interpreter is loaded
+         * elsewhere, 0 when one of them is not in a committed region.
+         */
+        [[nodiscard]] inline uint64_t discoveryFingerprint(const std::vector<PVOID> &typeTypes) const {
+            std::vector<uint64_t> layout;
+            for (auto typeType: typeTypes) {
+                auto region = committedRegions->upper_bound(typeType);
+                if (region == committedRegions->begin()) {
+                    return 0;
+                }
+                region--;
+                if ((LPBYTE) typeType >= (LPBYTE) region->first + region->second->regionSize) {
+                    return 0;
+                }
+                layout.push_back((uint64_t) region->first);
+                layout.push_back(region->second->regionSize);
+            }
+            return hashPage((const byte *) layout.data(), layout.size() * sizeof(uint64_t));
+        }
+
+        /**
+         * Whether `typeObject` is a type object named `name` whose type is in `metaTypes`. A couple of reads, used
+         * to check cached addresses instead of scanning for them.
+         */
+        [[nodiscard]] inline bool isTypeObjectNamed(PVOID typeObject, const USP &metaTypes,
+                                                    std::string_view name) const {
+            auto object = readCachedValue<py27::PyTypeObject>(typeObject);
+            return object.has_value() && metaTypes.contains(object->ob_base.ob_type) &&
+                   readCachedNullTerminatedAsciiStringView(object->tp_name, name.size() + 1) == name;
+        }
+
+        /**
+         * Takes the type type and builtin types from the discovery cache if every one of them still checks out.
+         */
+        inline bool restorePythonTypes() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::discoveryRestore);
+            if (!cachedDiscovery.has_value()) {
+                return false;
+            }
+            auto typeTypes = cachedDiscovery->find("type");
+            auto builtins = cachedDiscovery->find("builtin");
+            if (typeTypes == nullptr || typeTypes->empty() || builtins == nullptr ||
+                builtins->size() != builtinTypeNames.size() ||
+                discoveryFingerprint(*typeTypes) != cachedDiscovery->fingerprint) {
+                return false;
+            }
+            auto restoredTypes = std::make_unique<USP>(typeTypes->begin(), typeTypes->end());
+            for (auto typeType: *typeTypes) {
+                if (!isTypeObjectNamed(typeType, USP{typeType}, "type"sv)) {
+                    return false;
+                }
+            }
+            for (SIZE_T i = 0; i < builtinTypeNames.size(); i++) {
+                if (!isTypeObjectNamed((*builtins)[i], *restoredTypes, builtinTypeNames[i])) {
+                    LOG_S(INFO) << std::format("cached builtin python type `{}` is stale.", builtinTypeNames[i]);
+                    return false;
+                }
+            }
+            pythonTypes = std::move(restoredTypes);
+            for (SIZE_T i = 0; i < builtinTypeNames.size(); i++) {
+                auto address = (*builtins)[i];
+                pythonBuiltinTypesMapping[address] = builtinTypeNames[i];
+                builtinTypeAddresses[i] = address;
+            }
+            confirmTypeType();
+            setBuiltinTypeRegions(builtinTypeAddresses[0]);
+            discovery.fingerprint = cachedDiscovery->fingerprint;
+            discovery.addresses["type"] = *typeTypes;
+            discovery.addresses["builtin"] = *builtins;
+            return true;
+        }
+        // Indexed by type id, see decodePythonValue().
+        std::vector<PyValueDecoder> valueDecoders;
+
+        static inline bool decodeStr(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                     PyValueBuffer &buffer) {
+            auto strObject = reader.readCachedValue<py27::PyVarObject>(address);
+            if (!strObject.has_value() || maxPythonTextLength < strObject->ob_size) {
+                return false;
+            }
+            auto chars = reader.readCachedSpan((LPBYTE) address + offsetof(py27::PyStrObject, ob_sval),
+                                               strObject->ob_size);
+            if (chars.size() != strObject->ob_size) {
+                return false;
+            }
+            value.kind = PyValueKind::string;
+            value.text = buffer.appendString({(const char *) chars.data(), chars.size()});
+            return true;
+        }
+
+        static inline bool decodeUnicode(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                         PyValueBuffer &buffer) {
+            auto unicodeObject = reader.readCachedValue<py27::PyUnicodeObject>(address);
+            if (!unicodeObject.has_value() || maxPythonTextLength < unicodeObject->length) {
+                return false;
+            }
+            auto units = reader.readCachedSpan(unicodeObject->str, unicodeObject->length * sizeof(char16_t));
+            if (units.size() != unicodeObject->length * sizeof(char16_t)) {
+                return false;
+            }
+            auto offset = (uint32_t) buffer.stringPool.size();
+            for (SIZE_T i = 0; i < unicodeObject->length; i++) {
+                auto unit = (uint32_t) (units[2 * i] | units[2 * i + 1] << 8);
+                auto codePoint = unit;
+                if (unit >= 0xD800 && unit < 0xDC00 && i + 1 < unicodeObject->length) {
+                    auto low = (uint32_t) (units[2 * i + 2] | units[2 * i + 3] << 8);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codePoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                        i++;
+                    }
+                }
+                appendUtf8(buffer.stringPool, codePoint);
+            }
+            value.kind = PyValueKind::string;
+            value.text = {offset, (uint32_t) (buffer.stringPool.size() - offset)};
+            return true;
+        }
+
+        static inline bool decodeInt(PythonMemoryReader &reader, PVOID address, PyValue &value, PyValueBuffer &) {
+            auto intObject = reader.readCachedValue<py27::PyIntObject>(address);
+            if (!intObject.has_value()) {
+                return false;
+            }
+            value.kind = PyValueKind::integer;
+            value.integer = intObject->ob_ival;
+            value.floating = (double) intObject->ob_ival;
+            return true;
+        }
+
+        static inline bool decodeBool(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                      PyValueBuffer &buffer) {
+            if (!decodeInt(reader, address, value, buffer)) {
+                return false;
+            }
+            value.kind = PyValueKind::boolean;
+            return true;
+        }
+
+        static inline bool decodeLong(PythonMemoryReader &reader, PVOID address, PyValue &value, PyValueBuffer &) {
+            auto longObject = reader.readCachedValue<py27::PyLongObject>(address);
+            if (!longObject.has_value()) {
+                return false;
+            }
+            // Unsigned, negating an untrusted INT64_MIN is undefined.
+            auto size = longObject->ob_size;
+            auto digitCount = size < 0 ? 0 - (uint64_t) size : (uint64_t) size;
+            if (maxLongDigits < digitCount) {
+                return false;
+            }
+            auto digits = reader.readCachedSpan((LPBYTE) address + offsetof(py27::PyLongObject, ob_digit),
+                                                digitCount * sizeof(uint32_t));
+            if (digits.size() != digitCount * sizeof(uint32_t)) {
+                return false;
+            }
+            uint64_t magnitude = 0;
+            double approximation = 0;
+            auto fits = true;
+            for (auto i = digitCount; i-- > 0;) {
+                uint32_t digit;
+                std::memcpy(&digit, digits.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+                fits = fits && (magnitude >> (63 - py27::longDigitBits)) == 0;
+                magnitude = (magnitude << py27::longDigitBits) | digit;
+                approximation = approximation * (double) (1ull << py27::longDigitBits) + digit;
+            }
+            auto negative = longObject->ob_size < 0;
+            value.kind = PyValueKind::integer;
+            value.integer = fits ? (negative ? -(int64_t) magnitude : (int64_t) magnitude) : 0;
+            value.floating = negative ? -approximation : approximation;
+            return true;
+        }
+
+        static inline bool decodeFloat(PythonMemoryReader &reader, PVOID address, PyValue &value, PyValueBuffer &) {
+            auto floatObject = reader.readCachedValue<py27::PyFloatObject>(address);
+            if (!floatObject.has_value()) {
+                return false;
+            }
+            value.kind = PyValueKind::floating;
+            value.floating = floatObject->ob_fval;
+            return true;
+        }
+
+        static inline bool decodeNone(PythonMemoryReader &, PVOID, PyValue &value, PyValueBuffer &) {
+            value.kind = PyValueKind::none;
+            return true;
+        }
+
+        static inline bool decodeList(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                      PyValueBuffer &buffer) {
+            value.firstItem = (uint32_t) buffer.items.size();
+            if (!reader.readPythonList(address, buffer.items, maxPythonItems)) {
+                return false;
+            }
+            value.kind = PyValueKind::list;
+            value.itemCount = (uint32_t) (buffer.items.size() - value.firstItem);
+            return true;
+        }
+
+        static inline bool decodeTuple(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                       PyValueBuffer &buffer) {
+            auto tupleObject = reader.readCachedValue<py27::PyVarObject>(address);
+            if (!tupleObject.has_value() || maxPythonItems < tupleObject->ob_size) {
+                return false;
+            }
+            auto itemBytes = reader.readCachedSpan((LPBYTE) address + offsetof(py27::PyTupleObject, ob_item),
+                                                   tupleObject->ob_size * sizeof(PVOID));
+            if (itemBytes.size() != tupleObject->ob_size * sizeof(PVOID)) {
+                return false;
+            }
+            value.kind = PyValueKind::tuple;
+            value.firstItem = (uint32_t) buffer.items.size();
+            value.itemCount = (uint32_t) tupleObject->ob_size;
+            buffer.items.resize(buffer.items.size() + tupleObject->ob_size);
+            std::memcpy(buffer.items.data() + value.firstItem, itemBytes.data(), itemBytes.size());
+            return true;
+        }
+
+        static inline bool decodeSet(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                     PyValueBuffer &buffer) {
+            auto setObject = reader.readCachedValue<py27::PySetObject>(address);
+            if (!setObject.has_value()) {
+                return false;
+            }
+            auto numberOfSlots = (SIZE_T) setObject->mask + 1;
+            if (!std::has_single_bit(numberOfSlots) || maxPythonItems < numberOfSlots) {
+                return false;
+            }
+            auto &entries = setEntryBuffer;
+            entries.resize(numberOfSlots);
+            auto smallTableAddress = (LPBYTE) address + offsetof(py27::PySetObject, smalltable);
+            if ((LPBYTE) setObject->table == smallTableAddress && numberOfSlots <= std::size(setObject->smalltable)) {
+                std::copy_n(setObject->smalltable, numberOfSlots, entries.begin());
+            } else {
+                auto entryBytes = reader.readCachedSpan(setObject->table, numberOfSlots * sizeof(py27::PySetEntry));
+                if (entryBytes.size() != numberOfSlots * sizeof(py27::PySetEntry)) {
+                    return false;
+                }
+                std::memcpy(entries.data(), entryBytes.data(), entryBytes.size());
+            }
+            value.kind = PyValueKind::set;
+            value.firstItem = (uint32_t) buffer.items.size();
+            for (auto &entry: entries) {
+                // Deleted entries keep the "<dummy key>" str, only present while fill exceeds used.
+                if (entry.key == nullptr || (setObject->fill != setObject->used &&
+                                             reader.readPythonStrView(entry.key, 16) == "<dummy key>"sv)) {
+                    continue;
+                }
+                buffer.items.push_back(entry.key);
+            }
+            value.itemCount = (uint32_t) (buffer.items.size() - value.firstItem);
+            return true;
+        }
+
+        static inline bool decodeDict(PythonMemoryReader &reader, PVOID address, PyValue &value,
+                                      PyValueBuffer &buffer) {
+            auto slots = reader.readPythonDictSlots(address);
+            if (!slots.has_value()) {
+                return false;
+            }
+            value.kind = PyValueKind::dict;
+            value.firstItem = (uint32_t) buffer.items.size();
+            for (auto &slot: *slots) {
+                if (slot.me_key == nullptr || slot.me_value == nullptr) {
                     continue;
                 }
-                auto candidate_tp_name = readCachedNullTerminatedAsciiString(
+                buffer.items.push_back(slot.me_key);
+                buffer.items.push_back(slot.me_value);
+            }
+            value.itemCount = (uint32_t) (buffer.items.size() - value.firstItem);
+            return true;
+        }
+
+        // In the order of builtinTypeNames.
+        static constexpr std::array<PyValueDecoder, builtinTypeNames.size()> builtinValueDecoders = {
+                decodeStr, decodeFloat, decodeDict, decodeInt, decodeUnicode, decodeLong, decodeList, decodeTuple,
+                decodeBool, decodeSet, decodeNone
+        };
+
+        inline void EnumerateCandidatesForPythonTypes() {
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::typeScan);
+            instrumentation.add(StageCounter::regionsVisited, committedRegions->size());
+            auto chunks = splitIntoScanChunks(*committedRegions, objectScanWindowWords);
+            auto chunkList = std::vector<std::vector<PVOID>>(chunks.size());
+            workerPool->parallelFor(chunks.size(), [&](SIZE_T i) {
+                EnumerateCandidatesForPythonTypesInScanChunk(chunks[i], chunkList[i]);
+            });
+            auto allCandidates = std::make_unique<USP>();
+            for (auto &chunkCandidates: chunkList) {
+                allCandidates->insert(chunkCandidates.begin(), chunkCandidates.end());
+            }
+            pythonTypes = std::move(allCandidates);
+        }
+
+    private:
+        static constexpr SIZE_T maxPythonItems = 16384;
+        static constexpr SIZE_T maxPythonTextLength = 1 << 20;
+        static constexpr SIZE_T maxLongDigits = 64;
+
+        static inline void appendUtf8(std::string &out, uint32_t codePoint) {
+            if (codePoint < 0x80) {
+                out.push_back((char) codePoint);
+            } else if (codePoint < 0x800) {
+                out.push_back((char) (0xC0 | codePoint >> 6));
+                out.push_back((char) (0x80 | (codePoint & 0x3F)));
+            } else if (codePoint < 0x10000) {
+                out.push_back((char) (0xE0 | codePoint >> 12));
+                out.push_back((char) (0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back((char) (0x80 | (codePoint & 0x3F)));
+            } else {
+                out.push_back((char) (0xF0 | codePoint >> 18));
+                out.push_back((char) (0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back((char) (0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back((char) (0x80 | (codePoint & 0x3F)));
+            }
+        }
+        static inline thread_local std::vector<py27::PyDictEntry> slotBuffer;
+        static inline thread_local std::vector<py27::PySetEntry> setEntryBuffer;
+
+        // ob_refcnt, ob_type, ob_size, tp_name of a PyTypeObject candidate.
+        static constexpr SIZE_T objectScanWindowWords = 4;
+
+        inline void EnumerateCandidatesForPythonTypesInScanChunk(const ScanChunk &chunk,
+                                                                 std::vector<PVOID> &candidates) const {
+            // Starts at chunk.beginWord, indices below are relative to the chunk.
+            auto memoryRegionContentAsULongArray = loadScanChunk(chunk, objectScanWindowWords).data();
+            if (memoryRegionContentAsULongArray == nullptr) {
+                return;
+            }
+            auto baseAddress = (uint64_t *) chunk.region->baseAddress + chunk.beginWord;
+
+            // Vectorized pre-filter for `ob_type == &object`, only its hits pay for the tp_name lookup.
+            std::vector<SIZE_T> selfTypedIndices;
+            kernels::findSelfReferences(memoryRegionContentAsULongArray, 0, chunk.endWord - chunk.beginWord,
+                                        (uint64_t) baseAddress, selfTypedIndices);
+            for (auto candidateAddressIndex: selfTypedIndices) {
+                auto candidateAddressInProcess = baseAddress + candidateAddressIndex;
+                auto candidate_tp_name = readCachedNullTerminatedAsciiStringView(
                         (PVOID) memoryRegionContentAsULongArray[candidateAddressIndex + 3],
                         16
                 );
-                if (candidate_tp_name == nullptr) {
-                    continue;
-                }
-                auto equal = *candidate_tp_name == "type";
-                if (!equal) {
+                if (candidate_tp_name != "type"sv) {
                     continue;
                 }
-                candidates->insert(candidateAddressInProcess);
+                candidates.push_back(candidateAddressInProcess);
             }
-            return candidates;
+            instrumentation.add(StageCounter::candidatesTested, selfTypedIndices.size());
+            instrumentation.add(StageCounter::candidatesAccepted, candidates.size());
         }
 
-        inline std::unordered_set<PVOID> *EnumerateCandidatesForPythonObjectsInMemoryRegion(
-                CPMR &region,
+        struct BucketedCandidate {
+            uint32_t bucket;
+            PVOID address;
+        };
+
+        inline void EnumerateCandidatesForPythonObjectsInScanChunk(
+                const ScanChunk &chunk,
                 const function<bool(uint64_t *)> &ob_type_filter,
-                const function<bool(PSTR const&)> &tp_name_filter
-        ) const {
-            if (region == nullptr || region->content.empty()) {
-                //LOG_S(WARNING) << "No committed regions loaded.";
-                return nullptr;
-            }
-            auto memoryRegionContentAsULongArray = (uint64_t *) region->content.data();
-            auto baseAddress = (uint64_t *) region->baseAddress;
-            auto longLength = region->content.size() / 8;
-            auto candidates = new std::unordered_set<PVOID>();
-
-            for (uint64_t candidateAddressIndex = 0; candidateAddressIndex < longLength - 4; candidateAddressIndex++) {
+                const function<int(std::string_view)> &tp_name_bucket,
+                std::vector<BucketedCandidate> &candidates
+        ) {
+            auto memoryRegionContentAsULongArray = loadScanChunk(chunk, objectScanWindowWords).data();
+            if (memoryRegionContentAsULongArray == nullptr) {
+                return;
+            }
+            auto baseAddress = (uint64_t *) chunk.region->baseAddress + chunk.beginWord;
+
+            // Counted once per chunk, the loop below is the hottest one of the discovery.
+            SIZE_T tested = 0;
+            for (SIZE_T candidateAddressIndex = 0; candidateAddressIndex < chunk.endWord - chunk.beginWord;
+                 candidateAddressIndex++) {
                 auto candidateAddressInProcess = baseAddress + candidateAddressIndex;
                 auto candidate_ob_type = (uint64_t *) memoryRegionContentAsULongArray[candidateAddressIndex + 1];
                 if (!ob_type_filter(candidate_ob_type)) {
                     continue;
                 }
-                auto candidate_tp_name = readCachedNullTerminatedAsciiString(
-                        (PVOID) memoryRegionContentAsULongArray[candidateAddressIndex + 3],
-                        16
-                );
-                if (!tp_name_filter(candidate_tp_name)) {
+                tested += 1;
+                // Confirmed type objects resolve through the type name cache, the others are not added to it.
+                auto typeId = typeNameCache.find(candidateAddressInProcess);
+                auto candidate_tp_name = typeId != TypeNameCache::invalidId ? typeNameCache.name(typeId)
+                                                                            : readCachedNullTerminatedAsciiStringView(
+                                (PVOID) memoryRegionContentAsULongArray[candidateAddressIndex + 3],
+                                16
+                        );
+                auto bucket = tp_name_bucket(candidate_tp_name);
+                if (bucket < 0) {
                     continue;
                 }
-                candidates->insert(candidateAddressInProcess);
+                candidates.push_back({(uint32_t) bucket, candidateAddressInProcess});
             }
-            return candidates;
+            instrumentation.add(StageCounter::candidatesTested, tested);
+            instrumentation.add(StageCounter::candidatesAccepted, candidates.size());
         }
 
         inline void EnumeratePythonBuiltinTypeAddresses() {
-            bool allFound = false;
+            ReaderInstrumentation::ScopedStage stage(instrumentation, ReaderStage::builtinTypeScan);
             int tries = 0;
-            while (!allFound) {
-                for (auto const &type: builtinTypeNames) {
-                    auto candidates = EnumerateCandidatesForPythonObjects(
-                            [this](uint64_t *ob_type) {
-                                return pythonTypes->contains(ob_type);
-                            },
-                            [&type](PSTR const &tp_name) {
-                                return tp_name != nullptr and *tp_name == type;
-                            },
-                            builtinTypeRegions
-                    );
-                    if (candidates != nullptr && candidates->size() == 1) {
-                        pythonBuiltinTypesMapping[*candidates->begin()] = type;
-                        setBuiltinTypeRegions(*candidates->begin());
-                        LOG_S(INFO) << std::format("builtin python type `{}` found @ 0x{:X}", type,
-                                                   (uint64_t) *candidates->begin());
+            while (pythonBuiltinTypesMapping.size() != builtinTypeNames.size()) {
+                auto candidatesByName = EnumerateCandidatesForPythonObjectsByTypeName(
+                        [this](uint64_t *ob_type) {
+                            return pythonTypes->contains(ob_type);
+                        },
+                        builtinTypeNames,
+                        builtinTypeRegions
+                );
+                for (SIZE_T i = 0; i < builtinTypeNames.size(); i++) {
+                    auto &candidates = candidatesByName[i];
+                    if (candidates.size() != 1 || pythonBuiltinTypesMapping.contains(*candidates.begin())) {
+                        continue;
                     }
+                    pythonBuiltinTypesMapping[*candidates.begin()] = builtinTypeNames[i];
+                    builtinTypeAddresses[i] = *candidates.begin();
+                    setBuiltinTypeRegions(*candidates.begin());
+                    LOG_S(INFO) << std::format("builtin python type `{}` found @ 0x{:X}", builtinTypeNames[i],
+                                               (uint64_t) *candidates.begin());
                 }
-                allFound = pythonBuiltinTypesMapping.size() == builtinTypeNames.size();
-                if (!allFound) {
+                if (pythonBuiltinTypesMapping.size() != builtinTypeNames.size()) {
                     tries += 1;
                     if (tries > 3) {
                         LOG_S(ERROR) << "Failed to find all builtin python types.";
-                        exit(-1);
+                        throw ReaderError("Failed to find all builtin python types.");
                     }
                 }
             }
+            confirmTypeType();
+        }
 
+        /**
+         * Takes the type of the builtin types as the `type` type, and seeds the type name cache with them.
+         */
+        inline void confirmTypeType() {
+            auto builtinType = readCachedValue<py27::PyTypeObject>(builtinTypeAddresses[0]);
+            confirmedTypeType = builtinType.has_value() ? builtinType->ob_base.ob_type : nullptr;
+            insertBuiltinTypeNames();
         }
 
-        inline void EnumerateCandidatesForPythonTypes() {
-            boost::asio::io_service ioService;
-            boost::asio::io_service::work work(ioService);
-
-            // Create a thread pool
-            std::vector<boost::shared_ptr<boost::thread>> threads;
-            for (int i = 0; i < numThreads; ++i) {
-                boost::shared_ptr<boost::thread> thread(new boost::thread(
-                        [ObjectPtr = &ioService] { return ObjectPtr->run(); }
-                ));
-                threads.push_back(thread);
-            }
-            auto regionList = new std::unordered_set<PVOID> *[committedRegions->size()];
-            for (auto [it, i] = std::tuple{committedRegions->begin(), 0}; it != committedRegions->end(); it++, i++) {
-                auto &region = it->second;
-                ioService.post([=, &region, this] {
-                    auto candidates = EnumerateCandidatesForPythonTypesInMemoryRegion(region);
-                    regionList[i] = candidates;
-                });
-            }
-            ioService.stop();
-            for (auto &thread: threads) {
-                thread->join();
+        inline void insertBuiltinTypeNames() {
+            for (SIZE_T i = 0; i < builtinTypeNames.size(); i++) {
+                typeNameCache.insert(builtinTypeAddresses[i], builtinTypeNames[i]);
             }
-            auto allCandidates = std::make_unique<USP>();
-            for (auto i = 0; i < committedRegions->size(); i++) {
-                auto regionCandidates = regionList[i];
-                if (regionCandidates == nullptr || regionCandidates->empty()) {
-                    continue;
-                }
-                allCandidates->insert_range(*regionCandidates);
-            }
-            pythonTypes = std::move(allCandidates);
         }
 
         inline void setBuiltinTypeRegions(PVOID anyBuiltinTypeAddr) {
@@ -377,7 +1144,7 @@ namespace eve {
             builtinTypeAddrMax = builtinTypeAddrMin + ~builtinTypeAddrMask;
             for (auto &[_, region]: *committedRegions) {
                 if ((uint64_t) region->baseAddress >= builtinTypeAddrMax ||
-                    (uint64_t) region->baseAddress + region->content.size() <= builtinTypeAddrMin) {
+                    (uint64_t) region->baseAddress + region->regionSize <= builtinTypeAddrMin) {
                     continue;
                 }
                 builtinTypeRegionsFiltered->insert(std::pair<PVOID, SPMR>(region->baseAddress, region));
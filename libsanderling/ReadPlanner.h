@@ -0,0 +1,199 @@
+//
+// Created by allan on 2024/4/18.
+//
+
+#pragma once
+
+#include "ProcessMemorySource.h"
+#include "PageHash.h"
+
+#include <algorithm>
+
+namespace eve {
+
+    /**
+     * Turns many small reads of the live process into a few large ones. Requests are collected with add(), then
+     * execute() sorts them, merges the ones that lie within `mergeGap` bytes of each other into page aligned spans
+     * and fetches all spans with one readBatch call (process_vm_readv on Linux). view() hands out the requested
+     * bytes from the span buffer.
+     *
+     * A span that cannot be read as a whole, e.g. because a merged gap is not mapped, falls back to reading its
+     * requests one by one, each retried like ProcessMemoryReader::readRawBytes(). A planner can be reused, buffers
+     * keep their capacity across clear().
+     *
+     * LazyRegionCache::prefetch() uses it to fetch the missing blocks of a UI tree level in one go.
+     */
+    class ReadPlanner {
+    public:
+        explicit ReadPlanner(SIZE_T mergeGap = cachePageSize, SIZE_T maxSpanBytes = 4 * 1024 * 1024) :
+                mergeGap(mergeGap), maxSpanBytes(maxSpanBytes) {}
+
+        /**
+         * Queues [address, address + length) and returns the handle to pass to view() after execute().
+         */
+        inline SIZE_T add(PVOID address, SIZE_T length) {
+            requests.push_back({(uint64_t) address, length});
+            return requests.size() - 1;
+        }
+
+        inline void execute(const ProcessMemorySource &source) {
+            plan();
+            std::vector<MemoryReadRequest> reads;
+            reads.reserve(spans.size());
+            for (auto &span: spans) {
+                reads.push_back({(PVOID) span.address, buffer.get() + span.bufferOffset, span.length});
+            }
+            source.readBatch(reads);
+            for (SIZE_T i = 0; i < spans.size(); i++) {
+                auto &span = spans[i];
+                span.complete = reads[i].bytesRead == reads[i].length;
+                if (span.complete) {
+                    continue;
+                }
+                for (auto request = span.firstRequest; request < span.endRequest; request++) {
+                    auto &planned = requests[order[request]];
+                    auto target = buffer.get() + span.bufferOffset + (planned.address - span.address);
+                    SIZE_T bytesRead;
+                    int tries = 0;
+                    do {
+                        bytesRead = source.read((PVOID) planned.address, target, planned.length);
+                        tries += 1;
+                    } while (tries <= 3 and bytesRead != planned.length);
+                    planned.complete = bytesRead == planned.length;
+                }
+                fallbackReads += span.endRequest - span.firstRequest;
+            }
+            for (auto &span: spans) {
+                if (!span.complete) {
+                    continue;
+                }
+                for (auto request = span.firstRequest; request < span.endRequest; request++) {
+                    requests[order[request]].complete = true;
+                }
+            }
+            executed = true;
+        }
+
+        /**
+         * Bytes of request `handle`, empty if they could not be read. Valid until clear() or the next execute().
+         */
+        [[nodiscard]] inline std::span<const byte> view(SIZE_T handle) const {
+            auto &request = requests[handle];
+            if (!executed || !request.complete) {
+                return {};
+            }
+            return {buffer.get() + request.bufferOffset, request.length};
+        }
+
+        inline void clear() {
+            requests.clear();
+            spans.clear();
+            order.clear();
+            fallbackReads = 0;
+            executed = false;
+        }
+
+        [[nodiscard]] inline SIZE_T requestCount() const {
+            return requests.size();
+        }
+
+        /**
+         * Bulk reads the last execute() issued.
+         */
+        [[nodiscard]] inline SIZE_T spanCount() const {
+            return spans.size();
+        }
+
+        [[nodiscard]] inline SIZE_T spanBytes() const {
+            SIZE_T bytes = 0;
+            for (auto &span: spans) {
+                bytes += span.length;
+            }
+            return bytes;
+        }
+
+        /**
+         * Single reads the last execute() needed for spans that could not be read as a whole.
+         */
+        [[nodiscard]] inline SIZE_T getFallbackReads() const {
+            return fallbackReads;
+        }
+
+    private:
+        struct PlannedRequest {
+            uint64_t address;
+            SIZE_T length;
+            SIZE_T bufferOffset = 0;
+            bool complete = false;
+        };
+
+        struct PlannedSpan {
+            uint64_t address;
+            SIZE_T length;
+            SIZE_T bufferOffset;
+            // [firstRequest, endRequest) of `order`.
+            SIZE_T firstRequest;
+            SIZE_T endRequest;
+            bool complete = false;
+        };
+
+        SIZE_T mergeGap;
+        SIZE_T maxSpanBytes;
+        std::vector<PlannedRequest> requests;
+        std::vector<SIZE_T> order;
+        std::vector<PlannedSpan> spans;
+        std::unique_ptr<byte[]> buffer;
+        SIZE_T bufferCapacity = 0;
+        SIZE_T fallbackReads = 0;
+        bool executed = false;
+
+        static constexpr uint64_t pageFloor(uint64_t address) {
+            return address - address % cachePageSize;
+        }
+
+        static constexpr uint64_t pageCeil(uint64_t address) {
+            return pageFloor(address + cachePageSize - 1);
+        }
+
+        inline void plan() {
+            spans.clear();
+            order.resize(requests.size());
+            for (SIZE_T i = 0; i < order.size(); i++) {
+                order[i] = i;
+                requests[i].complete = false;
+            }
+            std::sort(order.begin(), order.end(), [this](SIZE_T a, SIZE_T b) {
+                return requests[a].address < requests[b].address;
+            });
+            SIZE_T bufferSize = 0;
+            for (SIZE_T i = 0; i < order.size(); i++) {
+                auto &request = requests[order[i]];
+                auto begin = pageFloor(request.address), end = pageCeil(request.address + request.length);
+                if (!spans.empty()) {
+                    auto &last = spans.back();
+                    auto lastEnd = last.address + last.length;
+                    if (begin <= lastEnd + mergeGap && std::max(end, lastEnd) - last.address <= maxSpanBytes) {
+                        last.length = std::max(end, lastEnd) - last.address;
+                        last.endRequest = i + 1;
+                        continue;
+                    }
+                    bufferSize += last.length;
+                }
+                spans.push_back({begin, end - begin, bufferSize, i, i + 1});
+            }
+            if (!spans.empty()) {
+                bufferSize += spans.back().length;
+            }
+            if (bufferCapacity < bufferSize) {
+                buffer = std::make_unique_for_overwrite<byte[]>(bufferSize);
+                bufferCapacity = bufferSize;
+            }
+            for (auto &span: spans) {
+                for (auto request = span.firstRequest; request < span.endRequest; request++) {
+                    auto &planned = requests[order[request]];
+                    planned.bufferOffset = span.bufferOffset + (planned.address - span.address);
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,339 @@
+//
+// Created by allan on 2024/4/24.
+//
+
+#pragma once
+
+#include "UITreePoller.h"
+
+namespace eve {
+
+    struct ServiceOptions {
+        // Threads of the worker pool shared by every client's scans and tree reads.
+        uint8_t numThreads = 4;
+        // Clients read at the same time, each one spreads its work over the shared pool.
+        uint8_t concurrentClients = 2;
+        // Bytes of fetched memory all clients together may hold, split by priority.
+        SIZE_T memoryBudget = 1ull * 1024 * 1024 * 1024;
+        // Per-client cache settings. The service always reads lazily, byteBudget is set from memoryBudget.
+        CacheOptions cacheOptions{};
+    };
+
+    struct ClientOptions {
+        // Higher goes first among clients that are due, and gets a bigger share of the memory budget.
+        uint32_t priority = 0;
+        // A refresh is due every interval, and should be done within `deadline` of being due.
+        std::chrono::nanoseconds interval = std::chrono::milliseconds(100);
+        std::chrono::nanoseconds deadline = std::chrono::milliseconds(100);
+        PollerOptions pollerOptions{};
+    };
+
+    struct ClientStats {
+        bool attached = false;
+        // The process could not be opened, discovered or read. A failed client is no longer scheduled.
+        bool failed = false;
+        std::string error;
+        uint64_t framesPublished = 0;
+        uint64_t framesDropped = 0;
+        uint64_t framesAcquired = 0;
+        // Frames finished later than their deadline, the first one (after the discovery) is not counted.
+        uint64_t deadlineMisses = 0;
+        std::chrono::nanoseconds lastReadTime{};
+        SIZE_T byteBudget = 0;
+        SIZE_T residentBytes = 0;
+    };
+
+    /**
+     * One process attached to a ReaderService. Frames are handed over like in UITreePoller, acquire() is wait-free
+     * and has a single consumer.
+     */
+    class ServiceClient {
+    public:
+        ServiceClient(PMS source, ClientOptions options) : source(std::move(source)), options(options) {}
+
+        ServiceClient(const ServiceClient &) = delete;
+
+        ServiceClient &operator=(const ServiceClient &) = delete;
+
+        /**
+         * The latest frame, nullptr until discovery and the first read are done.
+         */
+        inline const UIFrame *acquire() {
+            if (frames.acquire()) {
+                framesAcquired.fetch_add(1, std::memory_order_relaxed);
+            }
+            auto &frame = frames.front();
+            return frame.sequence == 0 ? nullptr : &frame;
+        }
+
+        [[nodiscard]] inline bool isAttached() const {
+            return attached.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] inline bool isFailed() const {
+            return failed.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] inline ClientStats getStats() const {
+            ClientStats stats;
+            stats.attached = isAttached();
+            stats.failed = isFailed();
+            if (stats.failed) {
+                stats.error = error;
+            }
+            stats.framesPublished = framesPublished.load(std::memory_order_relaxed);
+            stats.framesDropped = framesDropped.load(std::memory_order_relaxed);
+            stats.framesAcquired = framesAcquired.load(std::memory_order_relaxed);
+            stats.deadlineMisses = deadlineMisses.load(std::memory_order_relaxed);
+            stats.lastReadTime = std::chrono::nanoseconds(lastReadNanoseconds.load(std::memory_order_relaxed));
+            stats.byteBudget = byteBudget.load(std::memory_order_relaxed);
+            if (stats.attached && reader->getLazyCache() != nullptr) {
+                stats.residentBytes = reader->getLazyCache()->getResidentBytes();
+            }
+            return stats;
+        }
+
+    private:
+        friend class ReaderService;
+
+        // Until discovery ran, then owned by the reader.
+        PMS source;
+        ClientOptions options;
+        // Set once under the service mutex, before `attached`.
+        unique_ptr<EVEOnlineReader> reader;
+        TripleBuffer<UIFrame> frames;
+        uint64_t sequence = 0;
+
+        // Scheduling state, guarded by the service mutex.
+        std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+        bool running = false;
+        bool detaching = false;
+
+        // Written once, before `failed`.
+        std::string error;
+
+        std::atomic<bool> attached = false;
+        std::atomic<bool> failed = false;
+        std::atomic<SIZE_T> byteBudget = 0;
+        std::atomic<uint64_t> framesPublished = 0;
+        std::atomic<uint64_t> framesDropped = 0;
+        std::atomic<uint64_t> framesAcquired = 0;
+        std::atomic<uint64_t> deadlineMisses = 0;
+        std::atomic<int64_t> lastReadNanoseconds = 0;
+
+        inline void fail(std::string message) {
+            LOG_S(WARNING) << std::format("reader service client failed: {}", message);
+            error = std::move(message);
+            failed.store(true, std::memory_order_release);
+        }
+    };
+
+    typedef std::shared_ptr<ServiceClient> SPSC;
+
+    /**
+     * Reads many processes with a fixed number of threads and a fixed amount of memory. Every client's reader runs
+     * in lazy mode on one shared WorkerPool, and a few driver threads take turns running the client that is due:
+     * discovery first, then a refresh and UI tree read every interval. Among due clients the highest priority goes
+     * first, then the earliest deadline.
+     *
+     * The memory budget is split across attached clients in proportion to priority + 1, and rebalanced whenever a
+     * client attaches or detaches.
+     */
+    class ReaderService {
+    public:
+        explicit ReaderService(ServiceOptions options = {}) : options(options),
+                                                              workerPool(make_shared<WorkerPool>(options.numThreads)) {
+            this->options.cacheOptions.lazy = true;
+            for (SIZE_T i = 0; i < std::max<uint8_t>(options.concurrentClients, 1); i++) {
+                drivers.emplace_back([this] { driverLoop(); });
+            }
+        }
+
+        ~ReaderService() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            for (auto &driver: drivers) {
+                driver.join();
+            }
+        }
+
+        ReaderService(const ReaderService &) = delete;
+
+        ReaderService &operator=(const ReaderService &) = delete;
+
+        /**
+         * Queues a process for discovery and returns right away, frames show up once it is attached. A source that is
+         * not open is not queued, the client comes back already failed.
+         */
+        inline SPSC attach(PMS source, ClientOptions clientOptions = {}) {
+            auto opened = source != nullptr && source->isOpen();
+            auto client = std::make_shared<ServiceClient>(std::move(source), clientOptions);
+            if (!opened) {
+                client->fail("Failed to open process.");
+                return client;
+            }
+            {
+                std::lock_guard lock(mutex);
+                clients.push_back(client);
+                rebalanceMemory();
+            }
+            wakeUp.notify_one();
+            return client;
+        }
+
+        inline SPSC attach(DWORD processId, ClientOptions clientOptions = {}) {
+            return attach(ProcessMemoryReader::openProcessMemorySource(processId), clientOptions);
+        }
+
+        /**
+         * Stops scheduling `client`, waiting for a read in progress. Its last frame stays readable. Failed clients
+         * were already dropped, detaching them is a no-op.
+         */
+        inline void detach(const SPSC &client) {
+            std::unique_lock lock(mutex);
+            client->detaching = true;
+            taskDone.wait(lock, [&client] { return !client->running; });
+            std::erase(clients, client);
+            rebalanceMemory();
+        }
+
+        [[nodiscard]] inline SIZE_T clientCount() const {
+            std::lock_guard lock(mutex);
+            return clients.size();
+        }
+
+        [[nodiscard]] inline const SPWP &getWorkerPool() const {
+            return workerPool;
+        }
+
+    private:
+        ServiceOptions options;
+        SPWP workerPool;
+        std::vector<boost::thread> drivers;
+
+        mutable std::mutex mutex;
+        std::condition_variable wakeUp;
+        std::condition_variable taskDone;
+        std::vector<SPSC> clients;
+        bool stopping = false;
+
+        /**
+         * The client to run next, nullptr if none is due before `now`. `nextDue` gets the earliest due time of
+         * the idle clients.
+         */
+        inline SPSC pickClient(std::chrono::steady_clock::time_point now,
+                               std::chrono::steady_clock::time_point &nextDue) const {
+            SPSC picked = nullptr;
+            nextDue = std::chrono::steady_clock::time_point::max();
+            for (auto &client: clients) {
+                if (client->running || client->detaching) {
+                    continue;
+                }
+                if (client->due > now) {
+                    nextDue = std::min(nextDue, client->due);
+                    continue;
+                }
+                if (picked == nullptr || client->options.priority > picked->options.priority ||
+                    (client->options.priority == picked->options.priority &&
+                     client->due + client->options.deadline < picked->due + picked->options.deadline)) {
+                    picked = client;
+                }
+            }
+            return picked;
+        }
+
+        inline void driverLoop() {
+            std::unique_lock lock(mutex);
+            while (!stopping) {
+                std::chrono::steady_clock::time_point nextDue;
+                auto client = pickClient(std::chrono::steady_clock::now(), nextDue);
+                if (client == nullptr && nextDue == std::chrono::steady_clock::time_point::max()) {
+                    wakeUp.wait(lock);
+                    continue;
+                } else if (client == nullptr) {
+                    wakeUp.wait_until(lock, nextDue);
+                    continue;
+                }
+                client->running = true;
+                auto discovery = client->reader == nullptr;
+                auto deadline = client->due + client->options.deadline;
+                lock.unlock();
+                std::optional<std::string> failure;
+                try {
+                    runClient(*client);
+                } catch (const std::exception &e) {
+                    failure = e.what();
+                } catch (...) {
+                    failure = "unknown error";
+                }
+                auto now = std::chrono::steady_clock::now();
+                if (!failure && !discovery && now > deadline) {
+                    client->deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+                }
+                lock.lock();
+                client->running = false;
+                client->due = std::max(client->due + client->options.interval, now);
+                if (failure) {
+                    client->fail(std::move(*failure));
+                    std::erase(clients, client);
+                    rebalanceMemory();
+                }
+                taskDone.notify_all();
+                wakeUp.notify_one();
+            }
+        }
+
+        inline void runClient(ServiceClient &client) {
+            if (client.reader == nullptr) {
+                auto cacheOptions = options.cacheOptions;
+                {
+                    std::lock_guard lock(mutex);
+                    cacheOptions.byteBudget = memoryShare(client.options.priority);
+                }
+                auto reader = make_unique<EVEOnlineReader>(std::move(client.source), options.numThreads,
+                                                           workerPool, cacheOptions);
+                std::lock_guard lock(mutex);
+                client.reader = std::move(reader);
+                client.attached.store(true, std::memory_order_release);
+                // The budget may have been split again during the discovery.
+                rebalanceMemory();
+            }
+            auto &frame = client.frames.back();
+            UITreePoller::captureFrame(*client.reader, client.options.pollerOptions, frame);
+            frame.sequence = ++client.sequence;
+            client.lastReadNanoseconds.store(frame.readTime.count(), std::memory_order_relaxed);
+            client.framesPublished.fetch_add(1, std::memory_order_relaxed);
+            if (client.frames.publish()) {
+                client.framesDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Share of the memory budget for a client of `priority`. Callers hold the mutex.
+         */
+        [[nodiscard]] inline SIZE_T memoryShare(uint32_t priority) const {
+            uint64_t totalWeight = 0;
+            for (auto &client: clients) {
+                totalWeight += client->options.priority + 1;
+            }
+            return options.memoryBudget / std::max<uint64_t>(totalWeight, 1) * (priority + 1);
+        }
+
+        /**
+         * Callers hold the mutex. LazyRegionCache::setByteBudget() is safe while the client is being read, blocks in
+         * use stay pinned by the reading threads.
+         */
+        inline void rebalanceMemory() {
+            for (auto &client: clients) {
+                auto share = memoryShare(client->options.priority);
+                client->byteBudget.store(share, std::memory_order_relaxed);
+                if (client->reader != nullptr && client->reader->getLazyCache() != nullptr) {
+                    client->reader->getLazyCache()->setByteBudget(share);
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,180 @@
+//
+// Created by allan on 2024/4/22.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace eve {
+
+    enum class ReaderStage : uint8_t {
+        // Enumerating the regions and copying their contents, on attach and by reloadCache().
+        regionLoad,
+        // refreshCache().
+        cacheRefresh,
+        // Checking the addresses of the discovery cache.
+        discoveryRestore,
+        // The self-typed `type` scan.
+        typeScan,
+        builtinTypeScan,
+        uiRootTypeScan,
+        uiRootObjectScan,
+        // readUITree() and readUITreeDelta().
+        uiTree,
+        count
+    };
+
+    static constexpr std::array<std::string_view, (SIZE_T) ReaderStage::count> readerStageNames{
+            "regionLoad", "cacheRefresh", "discoveryRestore", "typeScan", "builtinTypeScan", "uiRootTypeScan",
+            "uiRootObjectScan", "uiTree"
+    };
+
+    enum class StageCounter : uint8_t {
+        bytesRead,
+        regionsVisited,
+        // Reads that came back short after all retries.
+        readFailures,
+        readRetries,
+        candidatesTested,
+        candidatesAccepted,
+        // Buffers the reader allocated for region contents and cache blocks.
+        allocations,
+        count
+    };
+
+    static constexpr std::array<std::string_view, (SIZE_T) StageCounter::count> stageCounterNames{
+            "bytesRead", "regionsVisited", "readFailures", "readRetries", "candidatesTested", "candidatesAccepted",
+            "allocations"
+    };
+
+    struct StageStats {
+        uint64_t calls = 0;
+        uint64_t nanoseconds = 0;
+        std::array<uint64_t, (SIZE_T) StageCounter::count> counters = {};
+
+        [[nodiscard]] inline uint64_t operator[](StageCounter counter) const {
+            return counters[(SIZE_T) counter];
+        }
+    };
+
+    struct ReaderStats {
+        std::array<StageStats, (SIZE_T) ReaderStage::count> stages = {};
+
+        [[nodiscard]] inline const StageStats &operator[](ReaderStage stage) const {
+            return stages[(SIZE_T) stage];
+        }
+    };
+
+    /**
+     * Per-stage wall time and counters of one reader. Counters are added to the innermost stage the reader is
+     * running, also from its worker threads, so stages of one reader should not overlap in time.
+     *
+     * Disabled, every call returns after one relaxed load.
+     */
+    class ReaderInstrumentation {
+    public:
+        /**
+         * Times a stage from construction to destruction and makes it the stage counters go to.
+         */
+        class ScopedStage {
+        public:
+            ScopedStage(ReaderInstrumentation &instrumentation, ReaderStage stage) :
+                    instrumentation(instrumentation.isEnabled() ? &instrumentation : nullptr), stage(stage) {
+                if (this->instrumentation == nullptr) {
+                    return;
+                }
+                previousStage = instrumentation.currentStage.exchange((uint8_t) stage, std::memory_order_relaxed);
+                begin = std::chrono::steady_clock::now();
+            }
+
+            ~ScopedStage() {
+                if (instrumentation == nullptr) {
+                    return;
+                }
+                auto elapsed = std::chrono::steady_clock::now() - begin;
+                auto &stats = instrumentation->stages[(SIZE_T) stage];
+                stats.calls.fetch_add(1, std::memory_order_relaxed);
+                stats.nanoseconds.fetch_add(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                        std::memory_order_relaxed);
+                instrumentation->currentStage.store(previousStage, std::memory_order_relaxed);
+            }
+
+            ScopedStage(const ScopedStage &) = delete;
+
+            ScopedStage &operator=(const ScopedStage &) = delete;
+
+        private:
+            ReaderInstrumentation *instrumentation;
+            ReaderStage stage;
+            uint8_t previousStage = noStage;
+            std::chrono::steady_clock::time_point begin;
+        };
+
+        explicit ReaderInstrumentation(bool enabled = false) : enabled(enabled) {}
+
+        ReaderInstrumentation(const ReaderInstrumentation &) = delete;
+
+        ReaderInstrumentation &operator=(const ReaderInstrumentation &) = delete;
+
+        [[nodiscard]] inline bool isEnabled() const {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        inline void setEnabled(bool enable) {
+            enabled.store(enable, std::memory_order_relaxed);
+        }
+
+        inline void add(StageCounter counter, uint64_t value = 1) {
+            if (!isEnabled() || value == 0) {
+                return;
+            }
+            auto stage = currentStage.load(std::memory_order_relaxed);
+            if (stage == noStage) {
+                return;
+            }
+            stages[stage].counters[(SIZE_T) counter].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] inline ReaderStats snapshot() const {
+            ReaderStats stats;
+            for (SIZE_T stage = 0; stage < stages.size(); stage++) {
+                stats.stages[stage].calls = stages[stage].calls.load(std::memory_order_relaxed);
+                stats.stages[stage].nanoseconds = stages[stage].nanoseconds.load(std::memory_order_relaxed);
+                for (SIZE_T counter = 0; counter < (SIZE_T) StageCounter::count; counter++) {
+                    stats.stages[stage].counters[counter] = stages[stage].counters[counter].load(
+                            std::memory_order_relaxed);
+                }
+            }
+            return stats;
+        }
+
+        inline void reset() {
+            for (auto &stage: stages) {
+                stage.calls.store(0, std::memory_order_relaxed);
+                stage.nanoseconds.store(0, std::memory_order_relaxed);
+                for (auto &counter: stage.counters) {
+                    counter.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        static constexpr uint8_t noStage = std::numeric_limits<uint8_t>::max();
+
+        struct AtomicStageStats {
+            std::atomic<uint64_t> calls = 0;
+            std::atomic<uint64_t> nanoseconds = 0;
+            std::array<std::atomic<uint64_t>, (SIZE_T) StageCounter::count> counters = {};
+        };
+
+        std::atomic<bool> enabled;
+        std::atomic<uint8_t> currentStage = noStage;
+        std::array<AtomicStageStats, (SIZE_T) ReaderStage::count> stages;
+    };
+}
@@ -0,0 +1,133 @@
+//
+// Created by allan on 2024/4/14.
+//
+
+#pragma once
+
+#include "common.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace eve {
+
+    /**
+     * One large anonymous mapping the eagerly cached region contents are carved out of. Allocations are not zeroed
+     * (the pages are fresh from the OS or hold the previous reload's bytes, the reads overwrite them anyway) and
+     * stay at the same offset until reset(). The mapping is kept across resets as long as it is large enough, so
+     * reloadCache() does not pay for the allocator or page faults again.
+     *
+     * Not thread-safe, allocations are made up front from a single thread.
+     */
+    class RegionArena {
+    public:
+        static constexpr SIZE_T alignment = 64;
+        static constexpr SIZE_T hugePageSize = 2 * 1024 * 1024;
+
+        /**
+         * `hugePages` asks for transparent huge pages, `prefault` populates the whole mapping when it is created.
+         * Both only have an effect on Linux.
+         */
+        explicit RegionArena(bool hugePages = true, bool prefault = false) : hugePages(hugePages), prefault(prefault) {}
+
+        ~RegionArena() {
+            unmap();
+        }
+
+        RegionArena(const RegionArena &) = delete;
+
+        RegionArena &operator=(const RegionArena &) = delete;
+
+        /**
+         * Forgets all allocations and makes sure `bytes` fit, only remapping when the current mapping is too small.
+         * Everything allocated before is invalid afterwards.
+         */
+        inline bool reset(SIZE_T bytes) {
+            used = 0;
+            if (bytes <= capacity) {
+                return true;
+            }
+            unmap();
+            // Some headroom, region sizes grow a little between reloads.
+            return map(roundUp(bytes + bytes / 8, hugePageSize));
+        }
+
+        /**
+         * Uninitialized, `alignment` aligned bytes, nullptr when the arena is full.
+         */
+        inline byte *allocate(SIZE_T length) {
+            auto offset = roundUp(used, alignment);
+            if (mapping == nullptr || offset + length > capacity) {
+                return nullptr;
+            }
+            used = offset + length;
+            return mapping + offset;
+        }
+
+        /**
+         * What an allocation of `length` bytes takes up in the arena, padding included.
+         */
+        static inline SIZE_T requiredBytes(SIZE_T length) {
+            return roundUp(length, alignment);
+        }
+
+        [[nodiscard]] inline SIZE_T getCapacity() const {
+            return capacity;
+        }
+
+        [[nodiscard]] inline SIZE_T getUsed() const {
+            return used;
+        }
+
+    private:
+        bool hugePages;
+        bool prefault;
+        byte *mapping = nullptr;
+        SIZE_T capacity = 0;
+        SIZE_T used = 0;
+
+        static constexpr SIZE_T roundUp(SIZE_T value, SIZE_T multiple) {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        inline bool map(SIZE_T length) {
+#ifdef _WIN32
+            mapping = (byte *) VirtualAlloc(nullptr, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+            auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_POPULATE
+            if (prefault) {
+                flags |= MAP_POPULATE;
+            }
+#endif
+            auto address = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+            mapping = address == MAP_FAILED ? nullptr : (byte *) address;
+#ifdef MADV_HUGEPAGE
+            if (mapping != nullptr && hugePages) {
+                madvise(mapping, length, MADV_HUGEPAGE);
+            }
+#endif
+#endif
+            if (mapping == nullptr) {
+                LOG_S(ERROR) << std::format("Failed to map a {} bytes region arena.", length);
+                return false;
+            }
+            capacity = length;
+            return true;
+        }
+
+        inline void unmap() {
+            if (mapping != nullptr) {
+#ifdef _WIN32
+                VirtualFree(mapping, 0, MEM_RELEASE);
+#else
+                munmap(mapping, capacity);
+#endif
+            }
+            mapping = nullptr;
+            capacity = 0;
+            used = 0;
+        }
+    };
+}
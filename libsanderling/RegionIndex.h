@@ -0,0 +1,145 @@
+//
+// Created by allan on 2024/4/8.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <algorithm>
+
+namespace eve {
+
+    struct RegionIndexEntry {
+        uint64_t baseAddress = 0;
+        uint64_t size = 0;
+        // nullptr for regions fetched on demand.
+        byte *content = nullptr;
+    };
+
+    /**
+     * Flat, sorted copy of the cached regions for the hot lookups:
+     *  - entries are contiguous, lookups binary search a vector instead of walking a std::map,
+     *  - a two-level page bitmap answers "is this pointer cached" without touching the entries,
+     *  - every thread remembers the region it hit last, consecutive reads usually land in the same one.
+     *
+     * rebuild() must not run concurrently with lookups.
+     */
+    class RegionIndex {
+    public:
+        static constexpr uint64_t pageShift = 12;
+        static constexpr uint64_t leafShift = 30;
+        static constexpr uint64_t pagesPerLeaf = 1ull << (leafShift - pageShift);
+        static constexpr uint64_t maxAddress = 1ull << 48;
+
+        template<class Regions>
+        inline void rebuild(const Regions &regions) {
+            entries.clear();
+            leaves.clear();
+            for (auto &[_, region]: regions) {
+                if (region == nullptr || region->cachedSize() == 0) {
+                    continue;
+                }
+                auto baseAddress = (uint64_t) region->baseAddress;
+                if (baseAddress + region->cachedSize() > maxAddress) {
+                    continue;
+                }
+                entries.push_back({baseAddress, region->cachedSize(), region->content.data()});
+            }
+            std::sort(entries.begin(), entries.end(), [](const RegionIndexEntry &a, const RegionIndexEntry &b) {
+                return a.baseAddress < b.baseAddress;
+            });
+            for (auto &entry: entries) {
+                markPages(entry.baseAddress, entry.baseAddress + entry.size);
+            }
+            generation = nextGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        [[nodiscard]] inline bool empty() const {
+            return entries.empty();
+        }
+
+        [[nodiscard]] inline SIZE_T size() const {
+            return entries.size();
+        }
+
+        [[nodiscard]] inline std::span<const RegionIndexEntry> regions() const {
+            return entries;
+        }
+
+        /**
+         * Page granular: true if the page holding `address` belongs to a cached region.
+         */
+        [[nodiscard]] inline bool contains(uint64_t address) const {
+            if (address >= maxAddress) {
+                return false;
+            }
+            auto leafIndex = address >> leafShift;
+            if (leafIndex >= leaves.size() || leaves[leafIndex] == nullptr) {
+                return false;
+            }
+            auto page = (address >> pageShift) & (pagesPerLeaf - 1);
+            return (leaves[leafIndex]->bits[page >> 6] >> (page & 63)) & 1;
+        }
+
+        [[nodiscard]] inline const RegionIndexEntry *find(uint64_t address) const {
+            auto &lastHit = lastHitOfThread;
+            if (lastHit.owner == this && lastHit.generation == generation) {
+                auto &entry = entries[lastHit.index];
+                if (address - entry.baseAddress < entry.size) {
+                    return &entry;
+                }
+            }
+            if (!contains(address)) {
+                return nullptr;
+            }
+            auto gt = std::upper_bound(entries.begin(), entries.end(), address,
+                                       [](uint64_t value, const RegionIndexEntry &entry) {
+                                           return value < entry.baseAddress;
+                                       });
+            if (gt == entries.begin()) {
+                return nullptr;
+            }
+            --gt;
+            if (address - gt->baseAddress >= gt->size) {
+                return nullptr;
+            }
+            lastHit = {this, generation, (SIZE_T) (gt - entries.begin())};
+            return &*gt;
+        }
+
+    private:
+        struct Leaf {
+            uint64_t bits[pagesPerLeaf / 64] = {};
+        };
+
+        // No default member initializers, the thread_local below is zero initialized anyway.
+        struct LastHit {
+            const RegionIndex *owner;
+            uint64_t generation;
+            SIZE_T index;
+        };
+
+        std::vector<RegionIndexEntry> entries;
+        std::vector<std::unique_ptr<Leaf>> leaves;
+        uint64_t generation = 0;
+
+        static inline std::atomic<uint64_t> nextGeneration = 0;
+        static inline thread_local LastHit lastHitOfThread;
+
+        inline void markPages(uint64_t begin, uint64_t end) {
+            for (auto page = begin >> pageShift; page <= (end - 1) >> pageShift; page++) {
+                auto leafIndex = page >> (leafShift - pageShift);
+                if (leafIndex >= leaves.size()) {
+                    leaves.resize(leafIndex + 1);
+                }
+                if (leaves[leafIndex] == nullptr) {
+                    leaves[leafIndex] = std::make_unique<Leaf>();
+                }
+                auto bit = page & (pagesPerLeaf - 1);
+                leaves[leafIndex]->bits[bit >> 6] |= 1ull << (bit & 63);
+            }
+        }
+    };
+}
@@ -0,0 +1,143 @@
+//
+// Created by allan on 2024/4/9.
+//
+
+#pragma once
+
+#include "common.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SANDERLING_X86_64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SANDERLING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SANDERLING_TARGET_AVX2
+#endif
+
+namespace eve::kernels {
+
+    /**
+     * Appends every word index `i` in [begin, end) of a region copy whose next word points back at the word
+     * itself: words[i + 1] == baseAddress + 8 * i. That is `ob_type == &object`, which only the `type` type
+     * satisfies. words[end] must be readable.
+     */
+    typedef void (*SelfReferenceScan)(const uint64_t *words, SIZE_T begin, SIZE_T end, uint64_t baseAddress,
+                                      std::vector<SIZE_T> &hits);
+
+    inline void findSelfReferencesScalar(const uint64_t *words, SIZE_T begin, SIZE_T end, uint64_t baseAddress,
+                                         std::vector<SIZE_T> &hits) {
+        auto expected = baseAddress + 8 * begin;
+        for (auto i = begin; i < end; i++, expected += 8) {
+            if (words[i + 1] == expected) {
+                hits.push_back(i);
+            }
+        }
+    }
+
+#ifdef SANDERLING_X86_64
+
+    inline void findSelfReferencesSSE2(const uint64_t *words, SIZE_T begin, SIZE_T end, uint64_t baseAddress,
+                                       std::vector<SIZE_T> &hits) {
+        auto i = begin;
+        auto expected = _mm_set_epi64x((int64_t) (baseAddress + 8 * i + 8), (int64_t) (baseAddress + 8 * i));
+        const auto step = _mm_set1_epi64x(16);
+        for (; i + 2 <= end; i += 2) {
+            auto lane = _mm_loadu_si128((const __m128i *) (words + i + 1));
+            // SSE2 has no 64 bit compare: both 32 bit halves have to match.
+            auto equal32 = _mm_cmpeq_epi32(lane, expected);
+            auto equal64 = _mm_and_si128(equal32, _mm_shuffle_epi32(equal32, _MM_SHUFFLE(2, 3, 0, 1)));
+            auto mask = _mm_movemask_pd(_mm_castsi128_pd(equal64));
+            expected = _mm_add_epi64(expected, step);
+            if (mask == 0) {
+                continue;
+            }
+            if (mask & 1) hits.push_back(i);
+            if (mask & 2) hits.push_back(i + 1);
+        }
+        findSelfReferencesScalar(words, i, end, baseAddress, hits);
+    }
+
+    SANDERLING_TARGET_AVX2
+    inline void findSelfReferencesAVX2(const uint64_t *words, SIZE_T begin, SIZE_T end, uint64_t baseAddress,
+                                       std::vector<SIZE_T> &hits) {
+        auto i = begin;
+        auto first = (int64_t) (baseAddress + 8 * i);
+        auto expected0 = _mm256_set_epi64x(first + 24, first + 16, first + 8, first);
+        auto expected1 = _mm256_add_epi64(expected0, _mm256_set1_epi64x(32));
+        const auto step = _mm256_set1_epi64x(64);
+        for (; i + 8 <= end; i += 8) {
+            auto lane0 = _mm256_loadu_si256((const __m256i *) (words + i + 1));
+            auto lane1 = _mm256_loadu_si256((const __m256i *) (words + i + 5));
+            auto equal0 = _mm256_cmpeq_epi64(lane0, expected0);
+            auto equal1 = _mm256_cmpeq_epi64(lane1, expected1);
+            expected0 = _mm256_add_epi64(expected0, step);
+            expected1 = _mm256_add_epi64(expected1, step);
+            if (_mm256_testz_si256(_mm256_or_si256(equal0, equal1), _mm256_or_si256(equal0, equal1))) {
+                continue;
+            }
+            auto mask = (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(equal0)) |
+                        (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(equal1)) << 4;
+            while (mask != 0) {
+                hits.push_back(i + std::countr_zero(mask));
+                mask &= mask - 1;
+            }
+        }
+        findSelfReferencesScalar(words, i, end, baseAddress, hits);
+    }
+
+    inline bool cpuSupportsAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        auto osxsave = (info[2] & (1 << 27)) != 0;
+        auto avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#endif
+
+    inline SelfReferenceScan selectSelfReferenceScan(const char **name = nullptr) {
+        SelfReferenceScan scan = findSelfReferencesScalar;
+        const char *selected = "scalar";
+#ifdef SANDERLING_X86_64
+        // SSE2 is part of x86-64.
+        scan = findSelfReferencesSSE2;
+        selected = "sse2";
+        if (cpuSupportsAVX2()) {
+            scan = findSelfReferencesAVX2;
+            selected = "avx2";
+        }
+#endif
+        if (name != nullptr) {
+            *name = selected;
+        }
+        return scan;
+    }
+
+    /**
+     * Runtime dispatched entry point, the CPU is probed once.
+     */
+    inline void findSelfReferences(const uint64_t *words, SIZE_T begin, SIZE_T end, uint64_t baseAddress,
+                                   std::vector<SIZE_T> &hits) {
+        static const auto scan = selectSelfReferenceScan();
+        scan(words, begin, end, baseAddress, hits);
+    }
+}
@@ -0,0 +1,476 @@
+//
+// Created by allan on 2024/4/25.
+//
+
+#pragma once
+
+#include "UITreePoller.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eve {
+
+    /**
+     * A block of memory shared between processes: a named POSIX shm object (a named file mapping on Windows), or
+     * for tests a plain in-process allocation standing in for one.
+     */
+    class SharedMemorySegment {
+    public:
+        /**
+         * Creates or resizes the segment `name` ("/sanderling-ui" on POSIX), nullptr on failure. The creator
+         * removes the name again when it is destroyed.
+         */
+        static inline std::shared_ptr<SharedMemorySegment> create(const std::string &name, SIZE_T size) {
+            std::shared_ptr<SharedMemorySegment> segment(new SharedMemorySegment());
+            segment->name = name;
+            segment->owner = true;
+            segment->writable = true;
+#ifdef _WIN32
+            segment->hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                                   (DWORD) ((uint64_t) size >> 32), (DWORD) size, name.c_str());
+            if (segment->hMapping == nullptr) {
+                LOG_S(ERROR) << std::format("Failed to create shared memory {}.", name);
+                return nullptr;
+            }
+            segment->mapping = (byte *) MapViewOfFile(segment->hMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+            auto fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+            if (fd < 0 || ftruncate(fd, (off_t) size) != 0) {
+                LOG_S(ERROR) << std::format("Failed to create shared memory {}.", name);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return nullptr;
+            }
+            auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            segment->mapping = address == MAP_FAILED ? nullptr : (byte *) address;
+#endif
+            segment->mappingSize = size;
+            return segment->mapping == nullptr ? nullptr : segment;
+        }
+
+        /**
+         * Maps an existing segment read-only, nullptr if there is none.
+         */
+        static inline std::shared_ptr<const SharedMemorySegment> open(const std::string &name) {
+            std::shared_ptr<SharedMemorySegment> segment(new SharedMemorySegment());
+            segment->name = name;
+#ifdef _WIN32
+            segment->hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+            if (segment->hMapping == nullptr) {
+                return nullptr;
+            }
+            segment->mapping = (byte *) MapViewOfFile(segment->hMapping, FILE_MAP_READ, 0, 0, 0);
+            MEMORY_BASIC_INFORMATION info;
+            if (segment->mapping == nullptr || VirtualQuery(segment->mapping, &info, sizeof(info)) == 0) {
+                return nullptr;
+            }
+            segment->mappingSize = info.RegionSize;
+#else
+            auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0) {
+                return nullptr;
+            }
+            struct stat segmentStat{};
+            if (fstat(fd, &segmentStat) != 0 || segmentStat.st_size == 0) {
+                close(fd);
+                return nullptr;
+            }
+            auto address = mmap(nullptr, (size_t) segmentStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (address == MAP_FAILED) {
+                return nullptr;
+            }
+            segment->mapping = (byte *) address;
+            segment->mappingSize = (SIZE_T) segmentStat.st_size;
+#endif
+            return segment;
+        }
+
+        /**
+         * In-process stand-in, zero filled like a fresh shm object.
+         */
+        static inline std::shared_ptr<SharedMemorySegment> local(SIZE_T size) {
+            std::shared_ptr<SharedMemorySegment> segment(new SharedMemorySegment());
+            segment->localStorage.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            segment->mapping = (byte *) segment->localStorage.data();
+            segment->mappingSize = size;
+            segment->writable = true;
+            return segment;
+        }
+
+        ~SharedMemorySegment() {
+            if (!localStorage.empty() || mapping == nullptr) {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(mapping);
+            CloseHandle(hMapping);
+#else
+            munmap(mapping, mappingSize);
+            if (owner) {
+                shm_unlink(name.c_str());
+            }
+#endif
+        }
+
+        SharedMemorySegment(const SharedMemorySegment &) = delete;
+
+        SharedMemorySegment &operator=(const SharedMemorySegment &) = delete;
+
+        [[nodiscard]] inline byte *data() const {
+            return mapping;
+        }
+
+        [[nodiscard]] inline SIZE_T size() const {
+            return mappingSize;
+        }
+
+        [[nodiscard]] inline bool isWritable() const {
+            return writable;
+        }
+
+    private:
+        SharedMemorySegment() = default;
+
+        std::string name;
+        bool owner = false;
+        bool writable = false;
+        byte *mapping = nullptr;
+        SIZE_T mappingSize = 0;
+        std::vector<uint64_t> localStorage;
+#ifdef _WIN32
+        HANDLE hMapping = nullptr;
+#endif
+    };
+
+    /**
+     * Frame ring layout:
+     *
+     *   FrameRingHeader
+     *   slot[slotCount]          @ frameRingHeaderBytes + i * slotBytes
+     *
+     * and per slot:
+     *
+     *   FrameSlotHeader
+     *   columns                  @ columns[column].offset from the slot, each aligned to 8 bytes
+     *
+     * Columns are the UITree columns as they are in memory, typeNames joined with '\0'. Slots are seqlocks: the
+     * version is odd while the publisher writes the slot, and a reader's copy is good if the version was even and
+     * the same before and after. Frame `sequence` goes to slot sequence % slotCount, so the slot of the latest frame
+     * is only rewritten after slotCount - 1 newer frames.
+     */
+    static constexpr char frameRingMagic[8] = {'S', 'D', 'L', 'R', 'I', 'N', 'G', '\0'};
+    static constexpr uint32_t frameRingVersion = 1;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+    struct FrameRingHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotCount;
+        uint64_t slotBytes;
+        // Sequence of the last complete frame, 0 before the first one.
+        std::atomic<uint64_t> latestSequence;
+    };
+
+    static constexpr SIZE_T frameRingHeaderBytes = 64;
+    static_assert(sizeof(FrameRingHeader) <= frameRingHeaderBytes);
+
+    enum FrameColumn : uint32_t {
+        frameAddress, frameParent, frameDepth, frameTypeId,
+        frameDisplayX, frameDisplayY, frameDisplayWidth, frameDisplayHeight,
+        frameName, frameText, frameHint,
+        frameTypeNames, frameStringPool,
+        frameColumnCount
+    };
+
+    struct FrameSlotHeader {
+        std::atomic<uint64_t> version;
+        uint64_t sequence;
+        // steady_clock, which is system wide on the platforms we support.
+        int64_t capturedAtNanoseconds;
+        uint64_t rowCount;
+        struct {
+            uint64_t offset;
+            uint64_t bytes;
+        } columns[frameColumnCount];
+    };
+
+    /**
+     * A frame in a ring slot, used in place. Everything here may be overwritten by the publisher at any time: use
+     * it, then check SharedFrameSubscriber::validate() before trusting what was read.
+     */
+    struct SharedFrame {
+        uint64_t sequence = 0;
+        std::chrono::steady_clock::time_point capturedAt;
+        std::span<const uint64_t> address;
+        std::span<const uint32_t> parent;
+        std::span<const uint16_t> depth;
+        std::span<const uint32_t> typeId;
+        std::span<const double> displayX;
+        std::span<const double> displayY;
+        std::span<const double> displayWidth;
+        std::span<const double> displayHeight;
+        std::span<const StringRef> name;
+        std::span<const StringRef> text;
+        std::span<const StringRef> hint;
+        // Joined with '\0'.
+        std::string_view typeNames;
+        std::string_view stringPool;
+
+        uint32_t slot = 0;
+        uint64_t version = 0;
+
+        [[nodiscard]] inline SIZE_T size() const {
+            return address.size();
+        }
+
+        [[nodiscard]] inline std::string_view string(StringRef ref) const {
+            return stringPool.substr(std::min<SIZE_T>(ref.offset, stringPool.size()), ref.length);
+        }
+    };
+
+    /**
+     * Writes frames into a ring in a SharedMemorySegment. There is one publisher per segment, it initializes the
+     * ring header.
+     */
+    class SharedFramePublisher {
+    public:
+        static inline SIZE_T requiredBytes(uint32_t slotCount, SIZE_T slotBytes) {
+            return frameRingHeaderBytes + slotCount * alignUp(slotBytes);
+        }
+
+        SharedFramePublisher(std::shared_ptr<SharedMemorySegment> segment, uint32_t slotCount = 4) :
+                segment(std::move(segment)) {
+            slotCount = std::max<uint32_t>(slotCount, 2);
+            if (this->segment == nullptr || !this->segment->isWritable() ||
+                this->segment->size() < requiredBytes(slotCount, sizeof(FrameSlotHeader))) {
+                LOG_S(ERROR) << "Shared memory segment too small for the frame ring.";
+                this->segment = nullptr;
+                return;
+            }
+            auto header = (FrameRingHeader *) this->segment->data();
+            std::memcpy(header->magic, frameRingMagic, sizeof(header->magic));
+            header->version = frameRingVersion;
+            header->slotCount = slotCount;
+            header->slotBytes = (this->segment->size() - frameRingHeaderBytes) / slotCount / 8 * 8;
+            sequence = header->latestSequence.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] inline bool isValid() const {
+            return segment != nullptr;
+        }
+
+        /**
+         * Copies `frame` into the next slot, false if the ring is invalid or the frame does not fit a slot.
+         */
+        inline bool publish(const UIFrame &frame) {
+            return publish(frame.tree, frame.capturedAt);
+        }
+
+        inline bool publish(const UITree &tree, std::chrono::steady_clock::time_point capturedAt) {
+            if (segment == nullptr) {
+                return false;
+            }
+            auto header = (FrameRingHeader *) segment->data();
+            joinedTypeNames.clear();
+            for (auto &typeName: tree.typeNames) {
+                joinedTypeNames.append(typeName);
+                joinedTypeNames.push_back('\0');
+            }
+            std::array<std::span<const byte>, frameColumnCount> columns{
+                    bytesOf(tree.address), bytesOf(tree.parent), bytesOf(tree.depth), bytesOf(tree.typeId),
+                    bytesOf(tree.displayX), bytesOf(tree.displayY), bytesOf(tree.displayWidth),
+                    bytesOf(tree.displayHeight), bytesOf(tree.name), bytesOf(tree.text), bytesOf(tree.hint),
+                    bytesOf(joinedTypeNames), bytesOf(tree.stringPool)
+            };
+
+            SIZE_T bytes = alignUp(sizeof(FrameSlotHeader));
+            for (auto &column: columns) {
+                bytes += alignUp(column.size());
+            }
+            if (bytes > header->slotBytes) {
+                LOG_S(WARNING) << std::format("UI tree frame of {} bytes does not fit the {} bytes ring slots.",
+                                              bytes, header->slotBytes);
+                return false;
+            }
+
+            auto frameSequence = sequence + 1;
+            auto slotIndex = (uint32_t) (frameSequence % header->slotCount);
+            auto slotBase = segment->data() + frameRingHeaderBytes + slotIndex * header->slotBytes;
+            auto slot = (FrameSlotHeader *) slotBase;
+            auto version = slot->version.load(std::memory_order_relaxed);
+            slot->version.store(version + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot->sequence = frameSequence;
+            slot->capturedAtNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    capturedAt.time_since_epoch()).count();
+            slot->rowCount = tree.size();
+            SIZE_T offset = alignUp(sizeof(FrameSlotHeader));
+            for (SIZE_T column = 0; column < frameColumnCount; column++) {
+                slot->columns[column] = {offset, columns[column].size()};
+                if (!columns[column].empty()) {
+                    std::memcpy(slotBase + offset, columns[column].data(), columns[column].size());
+                }
+                offset += alignUp(columns[column].size());
+            }
+
+            slot->version.store(version + 2, std::memory_order_release);
+            header->latestSequence.store(frameSequence, std::memory_order_release);
+            sequence = frameSequence;
+            return true;
+        }
+
+    private:
+        std::shared_ptr<SharedMemorySegment> segment;
+        uint64_t sequence = 0;
+        std::string joinedTypeNames;
+
+        static constexpr SIZE_T alignUp(SIZE_T bytes) {
+            return (bytes + 7) / 8 * 8;
+        }
+
+        template<class C>
+        static inline std::span<const byte> bytesOf(const C &column) {
+            return {(const byte *) column.data(), column.size() * sizeof(typename C::value_type)};
+        }
+    };
+
+    /**
+     * Reads the latest frame of a ring without locks and without waiting for the publisher.
+     */
+    class SharedFrameSubscriber {
+    public:
+        explicit SharedFrameSubscriber(std::shared_ptr<const SharedMemorySegment> segment) :
+                segment(std::move(segment)) {}
+
+        /**
+         * False until the publisher initialized the ring.
+         */
+        [[nodiscard]] inline bool isValid() const {
+            if (segment == nullptr || segment->size() < frameRingHeaderBytes) {
+                return false;
+            }
+            auto header = (const FrameRingHeader *) segment->data();
+            return std::memcmp(header->magic, frameRingMagic, sizeof(frameRingMagic)) == 0 &&
+                   header->version == frameRingVersion && header->slotCount >= 2 &&
+                   frameRingHeaderBytes + header->slotCount * header->slotBytes <= segment->size();
+        }
+
+        [[nodiscard]] inline uint64_t latestSequence() const {
+            if (!isValid()) {
+                return 0;
+            }
+            return ((const FrameRingHeader *) segment->data())->latestSequence.load(std::memory_order_acquire);
+        }
+
+        /**
+         * The latest frame in place, nullopt if there is none or its slot is being rewritten right now.
+         */
+        [[nodiscard]] inline std::optional<SharedFrame> acquire() const {
+            auto sequence = latestSequence();
+            if (sequence == 0) {
+                return std::nullopt;
+            }
+            auto header = (const FrameRingHeader *) segment->data();
+            SharedFrame frame;
+            frame.slot = (uint32_t) (sequence % header->slotCount);
+            auto slotBase = segment->data() + frameRingHeaderBytes + frame.slot * header->slotBytes;
+            auto slot = (const FrameSlotHeader *) slotBase;
+            frame.version = slot->version.load(std::memory_order_acquire);
+            if (frame.version % 2 != 0) {
+                return std::nullopt;
+            }
+            frame.sequence = slot->sequence;
+            frame.capturedAt = std::chrono::steady_clock::time_point(
+                    std::chrono::nanoseconds(slot->capturedAtNanoseconds));
+            auto rows = slot->rowCount;
+            for (auto &column: slot->columns) {
+                // A torn header is caught by validate(), it only must not send us outside the slot.
+                if (column.offset > header->slotBytes || column.bytes > header->slotBytes - column.offset) {
+                    return std::nullopt;
+                }
+            }
+            auto column = [slotBase, slot, rows]<class T>(FrameColumn index, std::span<const T> &out) {
+                out = {(const T *) (slotBase + slot->columns[index].offset),
+                       std::min<SIZE_T>(rows, slot->columns[index].bytes / sizeof(T))};
+            };
+            column(frameAddress, frame.address);
+            column(frameParent, frame.parent);
+            column(frameDepth, frame.depth);
+            column(frameTypeId, frame.typeId);
+            column(frameDisplayX, frame.displayX);
+            column(frameDisplayY, frame.displayY);
+            column(frameDisplayWidth, frame.displayWidth);
+            column(frameDisplayHeight, frame.displayHeight);
+            column(frameName, frame.name);
+            column(frameText, frame.text);
+            column(frameHint, frame.hint);
+            frame.typeNames = {(const char *) slotBase + slot->columns[frameTypeNames].offset,
+                               slot->columns[frameTypeNames].bytes};
+            frame.stringPool = {(const char *) slotBase + slot->columns[frameStringPool].offset,
+                                slot->columns[frameStringPool].bytes};
+            return frame;
+        }
+
+        /**
+         * True if nothing read from `frame` so far can have been overwritten.
+         */
+        [[nodiscard]] inline bool validate(const SharedFrame &frame) const {
+            auto header = (const FrameRingHeader *) segment->data();
+            auto slot = (const FrameSlotHeader *) (segment->data() + frameRingHeaderBytes +
+                                                   frame.slot * header->slotBytes);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot->version.load(std::memory_order_relaxed) == frame.version;
+        }
+
+        /**
+         * Copies the latest frame into `tree`, retrying while the publisher overwrites it. Returns its sequence, 0 if
+         * there was no frame or no consistent copy within `maxTries`.
+         */
+        inline uint64_t copyLatest(UITree &tree, SIZE_T maxTries = 8) const {
+            for (SIZE_T i = 0; i < maxTries; i++) {
+                auto frame = acquire();
+                if (!frame.has_value()) {
+                    continue;
+                }
+                tree.clear();
+                tree.address.assign((const PVOID *) frame->address.data(),
+                                    (const PVOID *) frame->address.data() + frame->address.size());
+                tree.parent.assign(frame->parent.begin(), frame->parent.end());
+                tree.depth.assign(frame->depth.begin(), frame->depth.end());
+                tree.typeId.assign(frame->typeId.begin(), frame->typeId.end());
+                tree.displayX.assign(frame->displayX.begin(), frame->displayX.end());
+                tree.displayY.assign(frame->displayY.begin(), frame->displayY.end());
+                tree.displayWidth.assign(frame->displayWidth.begin(), frame->displayWidth.end());
+                tree.displayHeight.assign(frame->displayHeight.begin(), frame->displayHeight.end());
+                tree.name.assign(frame->name.begin(), frame->name.end());
+                tree.text.assign(frame->text.begin(), frame->text.end());
+                tree.hint.assign(frame->hint.begin(), frame->hint.end());
+                tree.stringPool.assign(frame->stringPool);
+                for (SIZE_T begin = 0; begin < frame->typeNames.size();) {
+                    auto end = frame->typeNames.find('\0', begin);
+                    end = end == std::string_view::npos ? frame->typeNames.size() : end;
+                    tree.typeNames.emplace_back(frame->typeNames.substr(begin, end - begin));
+                    begin = end + 1;
+                }
+                if (validate(*frame)) {
+                    return frame->sequence;
+                }
+            }
+            tree.clear();
+            return 0;
+        }
+
+    private:
+        std::shared_ptr<const SharedMemorySegment> segment;
+    };
+}
@@ -0,0 +1,618 @@
+//
+// Created by allan on 2024/4/21.
+//
+
+#pragma once
+
+#include "PythonMemoryReader.h"
+
+namespace eve {
+
+    struct SyntheticHeapOptions {
+        // Total bytes of the address space, filler regions are added until it is reached.
+        SIZE_T heapBytes = 256ull * 1024 * 1024;
+        SIZE_T fillerRegionSize = 16ull * 1024 * 1024;
+        // UI tree below UIRoot: levels below the root and children per node.
+        uint32_t treeDepth = 5;
+        uint32_t treeFanOut = 4;
+        // Objects that look almost like the ones discovery looks for: self-typed objects not named `type`, types
+        // named like UIRoot or a builtin, a UIRoot whose type is not a type.
+        uint32_t nearMisses = 16;
+        // Children whose dict or children list is garbage, hung into the tree besides the valid nodes.
+        uint32_t garbageNodes = 8;
+        // Room left at the end of the object region for the values and nodes the changes below allocate.
+        SIZE_T changeBytes = 256 * 1024;
+        uint64_t seed = 1;
+    };
+
+    /**
+     * A fake EVE address space laid out like the py27 structures, deterministic for a given set of options. The
+     * interpreter region holds the self-typed `type` and the builtin types, the object region the UI types, the
+     * near misses and a UI tree below one UIRoot object. Node values mix float and int numbers, str and unicode
+     * texts, PyColor and Bunch objects.
+     *
+     * Filler regions are not stored, their words are derived from their address, a quarter of them pointer-like,
+     * so a heap of several GB costs nothing until it is read.
+     *
+     * The tree can be changed afterwards like the game would: nodes moved, renamed, added and removed. Changes are
+     * not synchronized with reads, make them while no reader runs on the heap.
+     */
+    class SyntheticHeap {
+    public:
+        static constexpr uint64_t interpreterBase = 0x1E000000;
+        static constexpr uint64_t objectBase = 0x200000000;
+        static constexpr uint64_t fillerBase = 0x240000000;
+
+        explicit SyntheticHeap(SyntheticHeapOptions options = {}) : options(options) {
+            interpreter.base = interpreterBase;
+            objects.base = objectBase;
+            build();
+            interpreter.size = roundToPage(interpreter.bytes.size());
+            objects.size = roundToPage(objects.bytes.size() + options.changeBytes);
+            for (auto address = fillerBase; contentBytes() + fillerBytes() < options.heapBytes;
+                 address += options.fillerRegionSize + cachePageSize) {
+                auto size = std::min<SIZE_T>(options.fillerRegionSize,
+                                             options.heapBytes - contentBytes() - fillerBytes());
+                fillerRegions.push_back({(PVOID) address, std::max<SIZE_T>(size / cachePageSize, 1) * cachePageSize});
+            }
+        }
+
+        SyntheticHeap(const SyntheticHeap &) = delete;
+
+        SyntheticHeap &operator=(const SyntheticHeap &) = delete;
+
+        [[nodiscard]] inline std::vector<MemoryRegionInfo> regions() const {
+            std::vector<MemoryRegionInfo> result{
+                    {(PVOID) interpreter.base, interpreter.size},
+                    {(PVOID) objects.base,     objects.size}
+            };
+            result.insert(result.end(), fillerRegions.begin(), fillerRegions.end());
+            return result;
+        }
+
+        inline SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const {
+            auto begin = (uint64_t) address;
+            for (auto segment: {&interpreter, &objects}) {
+                if (begin < segment->base || begin >= segment->base + segment->size) {
+                    continue;
+                }
+                auto bytesRead = std::min<SIZE_T>(length, segment->base + segment->size - begin);
+                auto offset = begin - segment->base;
+                auto stored = offset < segment->bytes.size() ? std::min(bytesRead, segment->bytes.size() - offset) : 0;
+                std::memcpy(buffer, segment->bytes.data() + offset, stored);
+                std::memset((byte *) buffer + stored, 0, bytesRead - stored);
+                return bytesRead;
+            }
+            auto region = std::upper_bound(fillerRegions.begin(), fillerRegions.end(), begin,
+                                           [](uint64_t address, const MemoryRegionInfo &region) {
+                                               return address < (uint64_t) region.baseAddress;
+                                           });
+            if (region == fillerRegions.begin()) {
+                return 0;
+            }
+            region--;
+            auto end = (uint64_t) region->baseAddress + region->regionSize;
+            if (begin >= end) {
+                return 0;
+            }
+            auto bytesRead = std::min<SIZE_T>(length, end - begin);
+            fill(begin, (byte *) buffer, bytesRead);
+            return bytesRead;
+        }
+
+        [[nodiscard]] inline SIZE_T totalBytes() const {
+            return contentBytes() + fillerBytes();
+        }
+
+        [[nodiscard]] inline PVOID getTypeType() const {
+            return typeType;
+        }
+
+        [[nodiscard]] inline PVOID getBuiltinType(std::string_view name) const {
+            return builtinTypes.at(std::string(name));
+        }
+
+        [[nodiscard]] inline PVOID getUIRoot() const {
+            return uiRoot;
+        }
+
+        /**
+         * Nodes a reader should find below and including UIRoot, the garbage nodes are not counted.
+         */
+        [[nodiscard]] inline SIZE_T getUINodeCount() const {
+            return uiNodeCount;
+        }
+
+        [[nodiscard]] inline SIZE_T getGarbageNodeCount() const {
+            return garbageNodeCount;
+        }
+
+        /**
+         * Every `str` object of the heap, keys and values.
+         */
+        [[nodiscard]] inline const std::vector<PVOID> &getStrings() const {
+            return strings;
+        }
+
+        /**
+         * Children of a UI node in list order, empty for a leaf.
+         */
+        [[nodiscard]] inline std::vector<PVOID> getChildren(PVOID node) const {
+            auto childrenList = getChildrenList(node);
+            if (childrenList == nullptr) {
+                return {};
+            }
+            auto listObject = load<py27::PyListObject>(objects, childrenList);
+            std::vector<PVOID> children(listObject.ob_base.ob_size);
+            std::memcpy(children.data(), objects.bytes.data() + ((uint64_t) listObject.ob_item - objects.base),
+                        children.size() * sizeof(PVOID));
+            return children;
+        }
+
+        /**
+         * Points _displayX and _displayY of `node` to new numbers.
+         */
+        inline void moveNode(PVOID node, int32_t displayX, int32_t displayY) {
+            setProperty(node, "_displayX", floatObject(displayX));
+            setProperty(node, "_displayY", floatObject(displayY));
+        }
+
+        inline void renameNode(PVOID node, std::string_view name) {
+            setProperty(node, "_name", str(name));
+        }
+
+        /**
+         * Stores a new width in the number object _displayWidth of `node` points to, like CPython handing a freed
+         * number out again at the same address.
+         */
+        inline void resizeNodeInPlace(PVOID node, int32_t displayWidth) {
+            auto value = load<PVOID>(objects, findDictValue(load<PVOID>(objects, (LPBYTE) node + 0x10),
+                                                            key("_displayWidth")));
+            if (load<py27::PyObject>(objects, value).ob_type == builtinTypes["float"]) {
+                write(objects, (LPBYTE) value + offsetof(py27::PyFloatObject, ob_fval), (double) displayWidth);
+            } else {
+                write(objects, (LPBYTE) value + offsetof(py27::PyIntObject, ob_ival), displayWidth);
+            }
+        }
+
+        /**
+         * Overwrites the characters of the str _name of `node` points to, `name` must have the same length.
+         */
+        inline void renameNodeInPlace(PVOID node, std::string_view name) {
+            auto value = load<PVOID>(objects, findDictValue(load<PVOID>(objects, (LPBYTE) node + 0x10),
+                                                            key("_name")));
+            writeBytes(objects, (LPBYTE) value + offsetof(py27::PyStrObject, ob_sval), name.data(), name.size());
+        }
+
+        /**
+         * Appends a new leaf to the children of `parent`, which must not be a leaf, and returns it.
+         */
+        inline PVOID addChild(PVOID parent) {
+            auto childrenList = getChildrenList(parent);
+            auto child = uiNode(nodeTypes[nextRandom() % nodeTypes.size()], options.treeDepth);
+            auto children = getChildren(parent);
+            children.push_back(child);
+            auto itemsAddress = allocate(objects, children.size() * sizeof(PVOID));
+            writeBytes(objects, itemsAddress, children.data(), children.size() * sizeof(PVOID));
+            write(objects, childrenList, py27::PyListObject{
+                    {1, (py27::PyTypeObject *) builtinTypes["list"], children.size()},
+                    (py27::PyObject **) itemsAddress, children.size()});
+            return child;
+        }
+
+        /**
+         * Unlinks the leaf `child` from the children of `parent`.
+         */
+        inline void removeChild(PVOID parent, PVOID child) {
+            auto childrenList = getChildrenList(parent);
+            auto children = getChildren(parent);
+            if (std::erase(children, child) == 0) {
+                return;
+            }
+            uiNodeCount -= 1;
+            auto listObject = load<py27::PyListObject>(objects, childrenList);
+            writeBytes(objects, listObject.ob_item, children.data(), children.size() * sizeof(PVOID));
+            listObject.ob_base.ob_size = children.size();
+            write(objects, childrenList, listObject);
+        }
+
+    private:
+        struct Segment {
+            uint64_t base = 0;
+            std::vector<byte> bytes;
+            // Of the region, set once the heap is built.
+            SIZE_T size = 0;
+        };
+
+        SyntheticHeapOptions options;
+        Segment interpreter;
+        Segment objects;
+        std::vector<MemoryRegionInfo> fillerRegions;
+        PVOID typeType = nullptr;
+        std::map<std::string, PVOID> builtinTypes;
+        std::map<std::string, PVOID> internedKeys;
+        std::vector<PVOID> strings;
+        PVOID uiRoot = nullptr;
+        SIZE_T uiNodeCount = 0;
+        SIZE_T garbageNodeCount = 0;
+        PVOID colorType = nullptr;
+        PVOID bunchType = nullptr;
+        PVOID childrenType = nullptr;
+        std::vector<PVOID> nodeTypes;
+        uint64_t randomState = 0;
+
+        // sizeof(PyTypeObject) of the 64 bit build, only the header and tp_name are filled.
+        static constexpr SIZE_T typeObjectSize = 0x198;
+        static constexpr SIZE_T instanceSize = 0x20;
+        // Never mapped, where garbage points to.
+        static constexpr uint64_t unmappedAddress = 0x7FF000000000;
+
+        static constexpr SIZE_T roundToPage(SIZE_T size) {
+            return std::max<SIZE_T>((size + cachePageSize - 1) / cachePageSize, 1) * cachePageSize;
+        }
+
+        static constexpr uint64_t mix(uint64_t value) {
+            value += 0x9E3779B97F4A7C15ull;
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        }
+
+        [[nodiscard]] inline SIZE_T contentBytes() const {
+            return interpreter.size + objects.size;
+        }
+
+        [[nodiscard]] inline SIZE_T fillerBytes() const {
+            SIZE_T bytes = 0;
+            for (auto &region: fillerRegions) {
+                bytes += region.regionSize;
+            }
+            return bytes;
+        }
+
+        inline void fill(uint64_t address, byte *buffer, SIZE_T length) const {
+            auto word = address & ~7ull;
+            auto skip = address - word;
+            while (length > 0) {
+                auto hash = mix(word ^ options.seed);
+                uint64_t value = (hash & 3) == 0 ? objectBase + (hash >> 8) % (fillerBase - objectBase) / 8 * 8 : hash;
+                auto count = std::min<SIZE_T>(8 - skip, length);
+                std::memcpy(buffer, (const byte *) &value + skip, count);
+                buffer += count;
+                length -= count;
+                word += 8;
+                skip = 0;
+            }
+        }
+
+        inline uint64_t nextRandom() {
+            return mix(randomState++);
+        }
+
+        inline PVOID allocate(Segment &segment, SIZE_T length) {
+            auto offset = (segment.bytes.size() + 15) / 16 * 16;
+            if (segment.size != 0 && offset + length > segment.size) {
+                throw std::length_error("synthetic heap: no room left for changes, raise changeBytes");
+            }
+            segment.bytes.resize(offset + length);
+            return (PVOID) (segment.base + offset);
+        }
+
+        template<class T>
+        [[nodiscard]] static inline T load(const Segment &segment, PVOID address) {
+            T value;
+            std::memcpy(&value, segment.bytes.data() + ((uint64_t) address - segment.base), sizeof(T));
+            return value;
+        }
+
+        template<class T>
+        inline void write(Segment &segment, PVOID address, const T &value) {
+            std::memcpy(segment.bytes.data() + ((uint64_t) address - segment.base), &value, sizeof(T));
+        }
+
+        inline void writeBytes(Segment &segment, PVOID address, const void *data, SIZE_T length) {
+            std::memcpy(segment.bytes.data() + ((uint64_t) address - segment.base), data, length);
+        }
+
+        inline PVOID cString(Segment &segment, std::string_view chars) {
+            auto address = allocate(segment, chars.size() + 1);
+            writeBytes(segment, address, chars.data(), chars.size());
+            return address;
+        }
+
+        inline PVOID typeObject(Segment &segment, std::string_view name, PVOID metaType) {
+            auto address = allocate(segment, typeObjectSize);
+            auto tpName = cString(segment, name);
+            write(segment, address, py27::PyTypeObject{{1, (py27::PyTypeObject *) (metaType ? metaType : address), 0},
+                                                       (char *) tpName});
+            return address;
+        }
+
+        inline PVOID str(std::string_view chars) {
+            auto address = allocate(objects, offsetof(py27::PyStrObject, ob_sval) + chars.size() + 1);
+            write(objects, address, py27::PyVarObject{1, (py27::PyTypeObject *) builtinTypes["str"], chars.size()});
+            write(objects, (LPBYTE) address + offsetof(py27::PyStrObject, ob_shash), (int64_t) -1);
+            writeBytes(objects, (LPBYTE) address + offsetof(py27::PyStrObject, ob_sval), chars.data(), chars.size());
+            strings.push_back(address);
+            return address;
+        }
+
+        /**
+         * Keys are interned, like the identifiers of real code.
+         */
+        inline PVOID key(const std::string &chars) {
+            auto interned = internedKeys.find(chars);
+            if (interned != internedKeys.end()) {
+                return interned->second;
+            }
+            return internedKeys[chars] = str(chars);
+        }
+
+        /**
+         * Address of the value pointer stored for `entryKey` in a dict of the object region, nullptr if it has none.
+         */
+        [[nodiscard]] inline PVOID findDictValue(PVOID dictAddress, PVOID entryKey) const {
+            auto dictObject = load<py27::PyDictObject>(objects, dictAddress);
+            for (uint64_t slot = 0; slot <= dictObject.ma_mask; slot++) {
+                auto entry = (LPBYTE) dictObject.ma_table + slot * sizeof(py27::PyDictEntry);
+                if (load<py27::PyDictEntry>(objects, entry).me_key == entryKey) {
+                    return entry + offsetof(py27::PyDictEntry, me_value);
+                }
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] inline PVOID getChildrenList(PVOID node) const {
+            auto childrenKey = internedKeys.find("children");
+            auto childrenObjectsKey = internedKeys.find("_childrenObjects");
+            if (childrenKey == internedKeys.end() || childrenObjectsKey == internedKeys.end()) {
+                return nullptr;
+            }
+            auto children = findDictValue(load<PVOID>(objects, (LPBYTE) node + 0x10), childrenKey->second);
+            if (children == nullptr) {
+                return nullptr;
+            }
+            auto childrenDict = load<PVOID>(objects, (LPBYTE) load<PVOID>(objects, children) + 0x10);
+            auto childrenList = findDictValue(childrenDict, childrenObjectsKey->second);
+            return childrenList == nullptr ? nullptr : load<PVOID>(objects, childrenList);
+        }
+
+        inline void setProperty(PVOID node, const std::string &name, PVOID value) {
+            auto slot = findDictValue(load<PVOID>(objects, (LPBYTE) node + 0x10), key(name));
+            if (slot != nullptr) {
+                write(objects, slot, value);
+            }
+        }
+
+        inline PVOID floatObject(double value) {
+            auto address = allocate(objects, sizeof(py27::PyFloatObject));
+            write(objects, address, py27::PyFloatObject{{1, (py27::PyTypeObject *) builtinTypes["float"]}, value});
+            return address;
+        }
+
+        inline PVOID intObject(int32_t value) {
+            auto address = allocate(objects, sizeof(py27::PyIntObject));
+            write(objects, address, py27::PyIntObject{{1, (py27::PyTypeObject *) builtinTypes["int"]}, value});
+            return address;
+        }
+
+        inline PVOID unicode(std::u16string_view chars) {
+            auto address = allocate(objects, sizeof(py27::PyUnicodeObject));
+            auto charsAddress = allocate(objects, (chars.size() + 1) * sizeof(char16_t));
+            writeBytes(objects, charsAddress, chars.data(), chars.size() * sizeof(char16_t));
+            write(objects, address, py27::PyUnicodeObject{{1, (py27::PyTypeObject *) builtinTypes["unicode"]},
+                                                          chars.size(), (char16_t *) charsAddress, -1, nullptr});
+            return address;
+        }
+
+        inline PVOID list(const std::vector<PVOID> &items) {
+            auto address = allocate(objects, sizeof(py27::PyListObject));
+            auto itemsAddress = allocate(objects, std::max<SIZE_T>(items.size(), 1) * sizeof(PVOID));
+            writeBytes(objects, itemsAddress, items.data(), items.size() * sizeof(PVOID));
+            write(objects, address, py27::PyListObject{{1, (py27::PyTypeObject *) builtinTypes["list"], items.size()},
+                                                       (py27::PyObject **) itemsAddress, items.size()});
+            return address;
+        }
+
+        inline PVOID dict(const std::vector<std::pair<PVOID, PVOID>> &entries) {
+            SIZE_T numberOfSlots = std::size(py27::PyDictObject{}.ma_smalltable);
+            while (numberOfSlots * 2 <= entries.size() * 3) {
+                numberOfSlots *= 2;
+            }
+            std::vector<py27::PyDictEntry> slots(numberOfSlots);
+            for (auto &[entryKey, value]: entries) {
+                auto hash = mix((uint64_t) entryKey);
+                auto slot = hash & (numberOfSlots - 1);
+                while (slots[slot].me_key != nullptr) {
+                    slot = (slot + 1) & (numberOfSlots - 1);
+                }
+                slots[slot] = {hash, (py27::PyObject *) entryKey, (py27::PyObject *) value};
+            }
+            auto address = allocate(objects, sizeof(py27::PyDictObject));
+            // ma_table is set below, ma_lookup stays null.
+            py27::PyDictObject dictObject{{1, (py27::PyTypeObject *) builtinTypes["dict"]}, entries.size(),
+                                          entries.size(), numberOfSlots - 1, nullptr, nullptr, {}};
+            if (numberOfSlots <= std::size(dictObject.ma_smalltable)) {
+                std::copy(slots.begin(), slots.end(), dictObject.ma_smalltable);
+                dictObject.ma_table = (py27::PyDictEntry *) ((LPBYTE) address +
+                                                             offsetof(py27::PyDictObject, ma_smalltable));
+            } else {
+                auto table = allocate(objects, numberOfSlots * sizeof(py27::PyDictEntry));
+                writeBytes(objects, table, slots.data(), numberOfSlots * sizeof(py27::PyDictEntry));
+                dictObject.ma_table = (py27::PyDictEntry *) table;
+            }
+            write(objects, address, dictObject);
+            return address;
+        }
+
+        /**
+         * Object of a user type, its __dict__ right after the header.
+         */
+        inline PVOID instance(PVOID type, PVOID instanceDict) {
+            auto address = allocate(objects, instanceSize);
+            write(objects, address, py27::PyObject{1, (py27::PyTypeObject *) type});
+            write(objects, (LPBYTE) address + 0x10, instanceDict);
+            return address;
+        }
+
+        inline PVOID color(float r, float g, float b, float a) {
+            return instance(colorType, dict({{key("_r"), floatObject(r)}, {key("_g"), floatObject(g)},
+                                             {key("_b"), floatObject(b)}, {key("_a"), floatObject(a)}}));
+        }
+
+        /**
+         * Bunch is a dict subclass, laid out like a dict.
+         */
+        inline PVOID bunch(const std::vector<std::pair<PVOID, PVOID>> &entries) {
+            auto address = dict(entries);
+            write(objects, (LPBYTE) address + offsetof(py27::PyObject, ob_type), bunchType);
+            return address;
+        }
+
+        inline void nearMisses() {
+            auto typo = typeObject(objects, "typo", nullptr);
+            // tp_name unmapped.
+            auto lost = typeObject(objects, "type", nullptr);
+            write(objects, (LPBYTE) lost + offsetof(py27::PyTypeObject, tp_name), unmappedAddress);
+            std::array selfTypedNames{"types", "Type", "typ", "type "};
+            std::array typedNames{"UIRoot_", "UIRoo", "uiroot", "strs", "dict2", "Int"};
+            for (uint32_t i = 0; i < options.nearMisses; i++) {
+                switch (i % 3) {
+                    case 0:
+                        typeObject(objects, selfTypedNames[i / 3 % selfTypedNames.size()], nullptr);
+                        break;
+                    case 1:
+                        typeObject(objects, typedNames[i / 3 % typedNames.size()], typeType);
+                        break;
+                    default:
+                        // Named UIRoot, but its type is not `type`, and an object of it.
+                        instance(typeObject(objects, "UIRoot", typo), dict({}));
+                        break;
+                }
+            }
+        }
+
+        /**
+         * Garbage dicts (too many slots, unmapped slot table, unmapped dict) make the reader skip the node, a
+         * garbage children list only drops its children.
+         */
+        inline PVOID garbageNode(PVOID type) {
+            auto kind = garbageNodeCount++ % 4;
+            if (kind == 3) {
+                uiNodeCount += 1;
+                auto childrenList = list({});
+                write(objects, (LPBYTE) childrenList + offsetof(py27::PyVarObject, ob_size), 1ull << 40);
+                auto children = instance(childrenType, dict({{key("_childrenObjects"), childrenList}}));
+                return instance(type, dict({{key("_name"), str("garbage children")}, {key("children"), children}}));
+            }
+            if (kind == 2) {
+                return instance(type, (PVOID) (unmappedAddress + 0x1000));
+            }
+            auto garbageDict = dict({{key("_name"), str("garbage")}});
+            auto dictObject = py27::PyDictObject{};
+            std::memcpy(&dictObject, objects.bytes.data() + ((uint64_t) garbageDict - objects.base), sizeof(dictObject));
+            if (kind == 0) {
+                dictObject.ma_mask = (1 << 20) - 1;
+            } else {
+                dictObject.ma_mask = 31;
+                dictObject.ma_table = (py27::PyDictEntry *) unmappedAddress;
+            }
+            write(objects, garbageDict, dictObject);
+            return instance(type, garbageDict);
+        }
+
+        inline void build() {
+            randomState = options.seed;
+            typeType = typeObject(interpreter, "type", nullptr);
+            for (auto name: {"str", "float", "dict", "int", "unicode", "long", "list", "tuple", "bool", "set",
+                             "NoneType"}) {
+                builtinTypes[name] = typeObject(interpreter, name, typeType);
+            }
+            // User types are heap types, they live among the objects.
+            auto uiRootType = typeObject(objects, "UIRoot", typeType);
+            childrenType = typeObject(objects, "UIChildrenListAutoSort", typeType);
+            colorType = typeObject(objects, "PyColor", typeType);
+            bunchType = typeObject(objects, "Bunch", typeType);
+            for (auto name: {"Container", "Sprite", "Fill", "Frame", "EveLabelMedium", "ButtonIcon"}) {
+                nodeTypes.push_back(typeObject(objects, name, typeType));
+            }
+            nearMisses();
+            uiRoot = uiNode(uiRootType, 0);
+        }
+
+        inline PVOID uiNode(PVOID type, uint32_t depth) {
+            uiNodeCount += 1;
+            auto number = [this](int32_t value) {
+                return nextRandom() % 4 == 0 ? intObject(value) : floatObject(value);
+            };
+            std::vector<std::pair<PVOID, PVOID>> entries{
+                    {key("_name"),          str(std::format("node_{}_{}", depth, uiNodeCount))},
+                    {key("_displayX"),      number((int32_t) (nextRandom() % 1920))},
+                    {key("_displayY"),      number((int32_t) (nextRandom() % 1080))},
+                    {key("_displayWidth"),  number((int32_t) (nextRandom() % 400))},
+                    {key("_displayHeight"), number((int32_t) (nextRandom() % 100))},
+                    {key("_opacity"),       floatObject(1.0)}
+            };
+            if (nextRandom() % 3 == 0) {
+                auto label = std::format("label {}", nextRandom() % 10000);
+                if (nextRandom() % 4 == 0) {
+                    // Non-ASCII text, with a surrogate pair.
+                    entries.emplace_back(key("_setText"), unicode(std::u16string(label.begin(), label.end()) +
+                                                                  u" \u00e9\u2713\U0001F680"));
+                } else {
+                    entries.emplace_back(key("_setText"), str(label));
+                }
+            }
+            if (nextRandom() % 8 == 0) {
+                entries.emplace_back(key("_hint"), str("hint"));
+            }
+            if (nextRandom() % 4 == 0) {
+                entries.emplace_back(key("_color"), color(1.0f, 0.5f, 0.25f, 1.0f));
+            }
+            if (nextRandom() % 8 == 0) {
+                entries.emplace_back(key("_sr"), bunch({{key("htmlstr"), str("<b>bunch</b>")}}));
+            }
+            if (depth < options.treeDepth) {
+                std::vector<PVOID> children;
+                for (uint32_t i = 0; i < options.treeFanOut; i++) {
+                    children.push_back(uiNode(nodeTypes[nextRandom() % nodeTypes.size()], depth + 1));
+                }
+                if (garbageNodeCount < options.garbageNodes && nextRandom() % 2 == 0) {
+                    children.push_back(garbageNode(nodeTypes[nextRandom() % nodeTypes.size()]));
+                }
+                auto childrenDict = dict({{key("_childrenObjects"), list(children)}});
+                entries.emplace_back(key("children"), instance(childrenType, childrenDict));
+            }
+            return instance(type, dict(entries));
+        }
+    };
+
+    /**
+     * ProcessMemorySource over a SyntheticHeap, several sources can share one heap.
+     */
+    class SyntheticMemorySource : public ProcessMemorySource {
+    public:
+        explicit SyntheticMemorySource(std::shared_ptr<const SyntheticHeap> heap, DWORD pid = 1) :
+                heap(std::move(heap)), pid(pid) {}
+
+        [[nodiscard]] bool isOpen() const override {
+            return heap != nullptr;
+        }
+
+        [[nodiscard]] DWORD processId() const override {
+            return pid;
+        }
+
+        [[nodiscard]] std::vector<MemoryRegionInfo> enumerateReadableRegions() const override {
+            return heap->regions();
+        }
+
+        SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const override {
+            return heap->read(address, buffer, length);
+        }
+
+    private:
+        std::shared_ptr<const SyntheticHeap> heap;
+        DWORD pid;
+    };
+}
@@ -0,0 +1,62 @@
+//
+// Created by allan on 2024/4/23.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <atomic>
+
+namespace eve {
+
+    /**
+     * Three slots handed between one writer and one reader without locks: the writer fills back(), publish()
+     * swaps it with the middle slot, acquire() swaps the middle slot with front() if it holds something newer.
+     * Both sides are wait-free, and each only ever touches the slot it owns.
+     */
+    template<class T>
+    class TripleBuffer {
+    public:
+        [[nodiscard]] inline T &back() {
+            return slots[backIndex];
+        }
+
+        /**
+         * Hands back() to the reader. Returns true if the value it replaces was never acquired.
+         */
+        inline bool publish() {
+            auto previous = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+            backIndex = previous & indexMask;
+            return (previous & freshBit) != 0;
+        }
+
+        /**
+         * Makes the last published value front(). Returns false, and leaves front() alone, if nothing was published
+         * since the previous call.
+         */
+        inline bool acquire() {
+            if ((middle.load(std::memory_order_relaxed) & freshBit) == 0) {
+                return false;
+            }
+            frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+            return true;
+        }
+
+        [[nodiscard]] inline const T &front() const {
+            return slots[frontIndex];
+        }
+
+    private:
+        static constexpr uint8_t indexMask = 0x3;
+        static constexpr uint8_t freshBit = 0x4;
+
+        std::array<T, 3> slots;
+        // Owned by the writer.
+        alignas(64) uint8_t backIndex = 0;
+        alignas(64) std::atomic<uint8_t> middle = 1;
+        // Owned by the reader.
+        alignas(64) uint8_t frontIndex = 2;
+    };
+}
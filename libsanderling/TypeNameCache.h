@@ -0,0 +1,148 @@
+//
+// Created by allan on 2024/4/17.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace eve {
+
+    /**
+     * Type object address -> interned type id and name, filled the first time a type is seen.
+     *
+     * Lookups never lock: the table is open addressing with a fixed capacity, an insert fills a slot's id before
+     * publishing its key, and names live in an array that is never reallocated. Inserts take a mutex. Type objects
+     * sharing a tp_name share the id.
+     */
+    class TypeNameCache {
+    public:
+        static constexpr uint32_t invalidId = std::numeric_limits<uint32_t>::max();
+
+        explicit TypeNameCache(SIZE_T maxTypes = 1 << 17) :
+                slotMask(std::bit_ceil(maxTypes * 2) - 1), maxTypes(maxTypes),
+                slots(std::make_unique<Slot[]>(slotMask + 1)), names(std::make_unique<std::string[]>(maxTypes)) {}
+
+        TypeNameCache(const TypeNameCache &) = delete;
+
+        TypeNameCache &operator=(const TypeNameCache &) = delete;
+
+        /**
+         * Id of the type object at `typeObject`, invalidId if it was not inserted yet.
+         */
+        [[nodiscard]] inline uint32_t find(PVOID typeObject) const {
+            auto key = (uint64_t) typeObject;
+            for (auto slot = hash(key);; slot = (slot + 1) & slotMask) {
+                auto slotKey = slots[slot].key.load(std::memory_order_acquire);
+                if (slotKey == key) {
+                    return slots[slot].id;
+                }
+                if (slotKey == 0) {
+                    return invalidId;
+                }
+            }
+        }
+
+        /**
+         * Name of a type id returned by find() or insert(). Valid for the lifetime of the cache.
+         */
+        [[nodiscard]] inline std::string_view name(uint32_t id) const {
+            return id < nameCount.load(std::memory_order_acquire) ? std::string_view(names[id]) : std::string_view();
+        }
+
+        /**
+         * Adds `typeObject` with `name` and returns its id, or the id it already has. invalidId once the cache is
+         * full.
+         */
+        inline uint32_t insert(PVOID typeObject, std::string_view typeName) {
+            auto key = (uint64_t) typeObject;
+            if (key == 0) {
+                return invalidId;
+            }
+            std::lock_guard lock(insertMutex);
+            auto slot = hash(key);
+            for (;; slot = (slot + 1) & slotMask) {
+                auto slotKey = slots[slot].key.load(std::memory_order_relaxed);
+                if (slotKey == key) {
+                    return slots[slot].id;
+                }
+                if (slotKey == 0) {
+                    break;
+                }
+            }
+            auto id = internLocked(typeName);
+            if (typeCount == maxTypes || id == invalidId) {
+                LOG_S(WARNING) << std::format("type name cache is full, {} types.", maxTypes);
+                return invalidId;
+            }
+            slots[slot].id = id;
+            slots[slot].key.store(key, std::memory_order_release);
+            typeCount += 1;
+            return id;
+        }
+
+        /**
+         * Id of `typeName` without any type object, so ids can be fixed before the types are found.
+         */
+        inline uint32_t intern(std::string_view typeName) {
+            std::lock_guard lock(insertMutex);
+            return internLocked(typeName);
+        }
+
+        /**
+         * Forgets every type object, the ids of the names stay. Must not run concurrently with find().
+         */
+        inline void clear() {
+            std::lock_guard lock(insertMutex);
+            for (SIZE_T slot = 0; slot <= slotMask; slot++) {
+                slots[slot].key.store(0, std::memory_order_relaxed);
+                slots[slot].id = invalidId;
+            }
+            typeCount = 0;
+        }
+
+        [[nodiscard]] inline SIZE_T size() const {
+            std::lock_guard lock(insertMutex);
+            return typeCount;
+        }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> key = 0;
+            uint32_t id = invalidId;
+        };
+
+        SIZE_T slotMask;
+        SIZE_T maxTypes;
+        std::unique_ptr<Slot[]> slots;
+        // Indexed by id, never reallocated so readers can hold on to the names.
+        std::unique_ptr<std::string[]> names;
+        std::atomic<uint32_t> nameCount = 0;
+        SIZE_T typeCount = 0;
+        std::unordered_map<std::string, uint32_t> nameIds;
+        mutable std::mutex insertMutex;
+
+        inline uint32_t internLocked(std::string_view typeName) {
+            if (auto interned = nameIds.find(std::string(typeName)); interned != nameIds.end()) {
+                return interned->second;
+            }
+            auto id = nameCount.load(std::memory_order_relaxed);
+            if (id == maxTypes) {
+                return invalidId;
+            }
+            names[id] = typeName;
+            nameIds.emplace(std::string(typeName), id);
+            nameCount.store(id + 1, std::memory_order_release);
+            return id;
+        }
+
+        [[nodiscard]] inline SIZE_T hash(uint64_t key) const {
+            // Type objects are at least 16 byte aligned.
+            return (SIZE_T) (((key >> 4) * 0x9E3779B97F4A7C15ull) >> 32) & slotMask;
+        }
+    };
+}
@@ -0,0 +1,67 @@
+//
+// Created by allan on 2024/4/10.
+//
+
+#pragma once
+
+#include "common.h"
+
+namespace eve {
+
+    /**
+     * Compile-time table of `tp_name`s looked for in a single scan, or of dict keys of interest. find() rejects most
+     * names by length alone before comparing any characters.
+     */
+    template<SIZE_T N>
+    class TypeNameTable {
+    public:
+        static constexpr SIZE_T maxNameLength = 63;
+
+        consteval explicit TypeNameTable(const std::array<std::string_view, N> &names) : names(names) {
+            for (auto &name: names) {
+                if (name.empty() || name.size() > maxNameLength) {
+                    throw "type names have to be 1 to 63 characters long";
+                }
+                lengthMask |= 1ull << name.size();
+            }
+        }
+
+        [[nodiscard]] static constexpr SIZE_T size() {
+            return N;
+        }
+
+        [[nodiscard]] constexpr std::string_view operator[](SIZE_T index) const {
+            return names[index];
+        }
+
+        [[nodiscard]] constexpr auto begin() const {
+            return names.begin();
+        }
+
+        [[nodiscard]] constexpr auto end() const {
+            return names.end();
+        }
+
+        /**
+         * Index of `name` in the table, -1 if it is not in there.
+         */
+        [[nodiscard]] constexpr int find(std::string_view name) const {
+            if (name.size() > maxNameLength || ((lengthMask >> name.size()) & 1) == 0) {
+                return -1;
+            }
+            for (SIZE_T i = 0; i < N; i++) {
+                if (names[i] == name) {
+                    return (int) i;
+                }
+            }
+            return -1;
+        }
+
+    private:
+        std::array<std::string_view, N> names;
+        uint64_t lengthMask = 0;
+    };
+
+    template<SIZE_T N>
+    TypeNameTable(const std::array<std::string_view, N> &) -> TypeNameTable<N>;
+}
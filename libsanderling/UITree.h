@@ -0,0 +1,112 @@
+//
+// Created by allan on 2024/4/16.
+//
+
+#pragma once
+
+#include "common.h"
+#include "PyValue.h"
+
+#include <limits>
+
+namespace eve {
+
+    /**
+     * The UI tree as flat columns, one row per node. Rows are in breadth-first order, so every parent row comes
+     * before its children and all rows of one depth are contiguous.
+     */
+    struct UITree {
+        static constexpr uint32_t noParent = std::numeric_limits<uint32_t>::max();
+
+        std::vector<PVOID> address;
+        std::vector<uint32_t> parent;
+        std::vector<uint16_t> depth;
+        // Index into typeNames.
+        std::vector<uint32_t> typeId;
+        // _displayX, _displayY, _displayWidth, _displayHeight, NaN where the node does not have them.
+        std::vector<double> displayX;
+        std::vector<double> displayY;
+        std::vector<double> displayWidth;
+        std::vector<double> displayHeight;
+        // _name, _setText or _text, _hint, empty where the node does not have them.
+        std::vector<StringRef> name;
+        std::vector<StringRef> text;
+        std::vector<StringRef> hint;
+
+        std::vector<std::string> typeNames;
+        std::string stringPool;
+
+        [[nodiscard]] inline SIZE_T size() const {
+            return address.size();
+        }
+
+        [[nodiscard]] inline bool empty() const {
+            return address.empty();
+        }
+
+        [[nodiscard]] inline std::string_view string(StringRef ref) const {
+            return std::string_view(stringPool).substr(ref.offset, ref.length);
+        }
+
+        /**
+         * Drops all rows but keeps the capacity, so a tree object can be reused frame after frame.
+         */
+        inline void clear() {
+            for (auto column: {&displayX, &displayY, &displayWidth, &displayHeight}) {
+                column->clear();
+            }
+            for (auto column: {&name, &text, &hint}) {
+                column->clear();
+            }
+            address.clear();
+            parent.clear();
+            depth.clear();
+            typeId.clear();
+            typeNames.clear();
+            stringPool.clear();
+        }
+    };
+
+    /**
+     * Bits of UITreeDelta::changedProperties.
+     */
+    enum UIProperty : uint32_t {
+        uiParent = 1 << 0,
+        uiDisplayX = 1 << 1,
+        uiDisplayY = 1 << 2,
+        uiDisplayWidth = 1 << 3,
+        uiDisplayHeight = 1 << 4,
+        uiName = 1 << 5,
+        uiText = 1 << 6,
+        uiHint = 1 << 7,
+    };
+
+    /**
+     * What changed between two reads of the UI tree, see EVEOnlineReader::readUITreeDelta(). Rows refer to the
+     * current tree, nodes that are gone can only be named by their address.
+     */
+    struct UITreeDelta {
+        std::vector<uint32_t> added;
+        std::vector<PVOID> removed;
+        std::vector<uint32_t> changed;
+        // UIProperty bits, one entry per row in `changed`.
+        std::vector<uint32_t> changedProperties;
+        // Nodes decoded from memory, and nodes taken over from the previous read because nothing they were
+        // decoded from changed.
+        SIZE_T decodedNodes = 0;
+        SIZE_T reusedNodes = 0;
+
+        [[nodiscard]] inline bool empty() const {
+            return added.empty() && removed.empty() && changed.empty();
+        }
+
+        inline void clear() {
+            added.clear();
+            removed.clear();
+            changed.clear();
+            changedProperties.clear();
+            decodedNodes = 0;
+            reusedNodes = 0;
+        }
+    };
+}
@@ -0,0 +1,189 @@
+//
+// Created by allan on 2024/4/23.
+//
+
+#pragma once
+
+#include "EVEOnlineReader.h"
+#include "TripleBuffer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace eve {
+
+    struct PollerOptions {
+        // Time between the starts of two polls. A poll that takes longer is followed by the next one right away.
+        std::chrono::nanoseconds interval = std::chrono::milliseconds(50);
+        SIZE_T maxDepth = 64;
+        SIZE_T maxNodes = 1 << 16;
+        // Refresh every region instead of only the ones holding eve objects, see refreshObjectRegions().
+        bool refreshAllRegions = false;
+    };
+
+    /**
+     * One poll of the UI tree. `delta` is relative to the previous frame the poller captured, which the consumer
+     * may not have seen: when `sequence` is not one past the last acquired frame, take the whole tree.
+     */
+    struct UIFrame {
+        // Starts at 1, 0 until the slot was first filled.
+        uint64_t sequence = 0;
+        std::chrono::steady_clock::time_point capturedAt;
+        // Refresh plus tree read.
+        std::chrono::nanoseconds readTime{};
+        UITree tree;
+        UITreeDelta delta;
+    };
+
+    struct PollerStats {
+        uint64_t framesPublished = 0;
+        // Published frames replaced by a newer one before the consumer acquired them.
+        uint64_t framesDropped = 0;
+        uint64_t framesAcquired = 0;
+        // Polls that took longer than the interval.
+        uint64_t overruns = 0;
+        std::chrono::nanoseconds lastReadTime{};
+    };
+
+    /**
+     * Polls an EVEOnlineReader on a background thread: every interval the eve object regions are refreshed and the
+     * UI tree is read again in delta mode into a triple buffer. The consumer takes the latest frame with acquire(),
+     * which is wait-free and never waits for a poll in progress.
+     *
+     * While the poller runs it is the only user of the reader. There is one consumer, a frame stays valid until its
+     * next acquire().
+     */
+    class UITreePoller {
+    public:
+        explicit UITreePoller(EVEOnlineReader &reader, PollerOptions options = {}) :
+                reader(reader), options(options), intervalNanoseconds(options.interval.count()) {}
+
+        ~UITreePoller() {
+            stop();
+        }
+
+        UITreePoller(const UITreePoller &) = delete;
+
+        UITreePoller &operator=(const UITreePoller &) = delete;
+
+        inline void start() {
+            if (thread.joinable()) {
+                return;
+            }
+            stopping = false;
+            thread = boost::thread([this] { pollLoop(); });
+        }
+
+        inline void stop() {
+            if (!thread.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard lock(stopMutex);
+                stopping = true;
+            }
+            stopRequested.notify_all();
+            thread.join();
+        }
+
+        [[nodiscard]] inline bool isRunning() const {
+            return thread.joinable();
+        }
+
+        inline void setInterval(std::chrono::nanoseconds interval) {
+            intervalNanoseconds.store(interval.count(), std::memory_order_relaxed);
+        }
+
+        /**
+         * The latest frame, nullptr until the first poll is done. Returns the same frame again if no newer one was
+         * published since the previous call.
+         */
+        inline const UIFrame *acquire() {
+            if (frames.acquire()) {
+                framesAcquired.fetch_add(1, std::memory_order_relaxed);
+            }
+            auto &frame = frames.front();
+            return frame.sequence == 0 ? nullptr : &frame;
+        }
+
+        /**
+         * Time since `frame` was captured.
+         */
+        [[nodiscard]] static inline std::chrono::nanoseconds frameAge(const UIFrame &frame) {
+            return std::chrono::steady_clock::now() - frame.capturedAt;
+        }
+
+        /**
+         * One poll into `frame`, everything but the sequence number.
+         */
+        static inline void captureFrame(EVEOnlineReader &reader, const PollerOptions &options, UIFrame &frame) {
+            auto begin = std::chrono::steady_clock::now();
+            if (options.refreshAllRegions) {
+                reader.refreshCache();
+            } else {
+                reader.refreshObjectRegions();
+            }
+            // Copy assignment keeps the capacity of the slot, steady frames do not allocate.
+            frame.tree = reader.readUITreeDelta(frame.delta, options.maxDepth, options.maxNodes);
+            frame.capturedAt = std::chrono::steady_clock::now();
+            frame.readTime = frame.capturedAt - begin;
+        }
+
+        [[nodiscard]] inline PollerStats getStats() const {
+            PollerStats stats;
+            stats.framesPublished = framesPublished.load(std::memory_order_relaxed);
+            stats.framesDropped = framesDropped.load(std::memory_order_relaxed);
+            stats.framesAcquired = framesAcquired.load(std::memory_order_relaxed);
+            stats.overruns = overruns.load(std::memory_order_relaxed);
+            stats.lastReadTime = std::chrono::nanoseconds(lastReadNanoseconds.load(std::memory_order_relaxed));
+            return stats;
+        }
+
+    private:
+        EVEOnlineReader &reader;
+        PollerOptions options;
+        TripleBuffer<UIFrame> frames;
+        uint64_t sequence = 0;
+
+        boost::thread thread;
+        std::mutex stopMutex;
+        std::condition_variable stopRequested;
+        bool stopping = false;
+
+        std::atomic<int64_t> intervalNanoseconds;
+        std::atomic<uint64_t> framesPublished = 0;
+        std::atomic<uint64_t> framesDropped = 0;
+        std::atomic<uint64_t> framesAcquired = 0;
+        std::atomic<uint64_t> overruns = 0;
+        std::atomic<int64_t> lastReadNanoseconds = 0;
+
+        inline void pollLoop() {
+            auto next = std::chrono::steady_clock::now();
+            std::unique_lock lock(stopMutex);
+            while (!stopping) {
+                lock.unlock();
+                poll();
+                lock.lock();
+                next += std::chrono::nanoseconds(intervalNanoseconds.load(std::memory_order_relaxed));
+                auto now = std::chrono::steady_clock::now();
+                if (next < now) {
+                    overruns.fetch_add(1, std::memory_order_relaxed);
+                    next = now;
+                }
+                stopRequested.wait_until(lock, next, [this] { return stopping; });
+            }
+        }
+
+        inline void poll() {
+            auto &frame = frames.back();
+            captureFrame(reader, options, frame);
+            frame.sequence = ++sequence;
+            lastReadNanoseconds.store(frame.readTime.count(), std::memory_order_relaxed);
+            framesPublished.fetch_add(1, std::memory_order_relaxed);
+            if (frames.publish()) {
+                framesDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+}
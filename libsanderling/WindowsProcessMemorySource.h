@@ -0,0 +1,73 @@
+//
+// Created by allan on 2024/4/6.
+//
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "ProcessMemorySource.h"
+
+namespace eve {
+
+    class WindowsProcessMemorySource : public ProcessMemorySource {
+    public:
+        explicit WindowsProcessMemorySource(DWORD processId) : pid(processId) {
+            hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
+        }
+
+        ~WindowsProcessMemorySource() override {
+            if (hProcess != nullptr) {
+                CloseHandle(hProcess);
+            }
+        }
+
+        [[nodiscard]] bool isOpen() const override {
+            return hProcess != nullptr;
+        }
+
+        [[nodiscard]] DWORD processId() const override {
+            return pid;
+        }
+
+        [[nodiscard]] uint64_t processStartTime() const override {
+            FILETIME creationTime, exitTime, kernelTime, userTime;
+            if (!GetProcessTimes(hProcess, &creationTime, &exitTime, &kernelTime, &userTime)) {
+                return 0;
+            }
+            return (uint64_t) creationTime.dwHighDateTime << 32 | creationTime.dwLowDateTime;
+        }
+
+        [[nodiscard]] std::vector<MemoryRegionInfo> enumerateReadableRegions() const override {
+            std::vector<MemoryRegionInfo> regions;
+            LPCVOID address = nullptr;
+            while (true) {
+                MEMORY_BASIC_INFORMATION memoryInfo;
+                auto result = VirtualQueryEx(hProcess, address, &memoryInfo, sizeof(memoryInfo));
+
+                if (result != sizeof(memoryInfo)) {
+                    break;
+                }
+                address = (LPBYTE) memoryInfo.BaseAddress + memoryInfo.RegionSize;
+                if (memoryInfo.State != MEM_COMMIT || memoryInfo.Protect & PAGE_GUARD ||
+                    memoryInfo.Protect & PAGE_NOACCESS) {
+                    continue;
+                }
+                regions.push_back({memoryInfo.BaseAddress, memoryInfo.RegionSize});
+            }
+            return regions;
+        }
+
+        SIZE_T read(PVOID address, LPVOID buffer, SIZE_T length) const override {
+            SIZE_T bytesRead = 0;
+            ReadProcessMemory(hProcess, address, buffer, length, &bytesRead);
+            return bytesRead;
+        }
+
+    private:
+        DWORD pid = 0;
+        HANDLE hProcess = nullptr;
+    };
+}
+
+#endif
@@ -0,0 +1,204 @@
+//
+// Created by allan on 2024/4/11.
+//
+
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+
+namespace eve {
+
+    /**
+     * Long-lived work-stealing thread pool. Every worker owns a deque: it pops its own tasks from the back and
+     * steals from the front of the others when it runs dry. One pool can be shared by several readers.
+     *
+     * parallelFor() lets the calling thread take part and run queued tasks before it blocks, so it may be called
+     * from inside a pool task without deadlocking.
+     */
+    class WorkerPool {
+    public:
+        explicit WorkerPool(SIZE_T numThreads = boost::thread::hardware_concurrency()) {
+            numThreads = std::max<SIZE_T>(numThreads, 1);
+            for (SIZE_T i = 0; i < numThreads; i++) {
+                queues.push_back(std::make_unique<TaskQueue>());
+            }
+            for (SIZE_T i = 0; i < numThreads; i++) {
+                threads.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard lock(sleepMutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            for (auto &thread: threads) {
+                thread.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool &) = delete;
+
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        [[nodiscard]] inline SIZE_T size() const {
+            return threads.size();
+        }
+
+        template<class F>
+        inline auto submit(F &&task) -> std::future<std::invoke_result_t<F>> {
+            typedef std::invoke_result_t<F> R;
+            auto packagedTask = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+            auto future = packagedTask->get_future();
+            push([packagedTask] { (*packagedTask)(); });
+            return future;
+        }
+
+        /**
+         * Calls body(i) for every i in [0, count) and returns once all calls are done. Indices are handed out one
+         * at a time, so uneven work items balance themselves. The first exception thrown by body is rethrown.
+         */
+        template<class F>
+        inline void parallelFor(SIZE_T count, F &&body) {
+            if (count == 0) {
+                return;
+            }
+            auto state = std::make_shared<ParallelForState>();
+            state->count = count;
+            state->body = [&body](SIZE_T i) { body(i); };
+
+            auto helpers = std::min(count - 1, size());
+            for (SIZE_T i = 0; i < helpers; i++) {
+                push([state] { state->run(); });
+            }
+            state->run();
+            // Every index is claimed once run() returns. Help with queued work while the claimed ones finish on
+            // other threads, then sleep until the last of them signals.
+            while (!state->done() && runPendingTask()) {
+            }
+            state->wait();
+            if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+        }
+
+    private:
+        struct TaskQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        struct ParallelForState {
+            SIZE_T count = 0;
+            std::function<void(SIZE_T)> body;
+            std::atomic<SIZE_T> next = 0;
+            std::atomic<SIZE_T> completed = 0;
+            // Guards error and the wake up of the caller.
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr error;
+
+            inline void run() {
+                SIZE_T i;
+                while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                    try {
+                        body(i);
+                    } catch (...) {
+                        std::lock_guard lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    if (completed.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+                        std::lock_guard lock(mutex);
+                        finished.notify_all();
+                    }
+                }
+            }
+
+            [[nodiscard]] inline bool done() const {
+                return completed.load(std::memory_order_acquire) == count;
+            }
+
+            inline void wait() {
+                std::unique_lock lock(mutex);
+                finished.wait(lock, [this] { return done(); });
+            }
+        };
+
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        std::vector<boost::thread> threads;
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        std::atomic<SIZE_T> pendingTasks = 0;
+        std::atomic<SIZE_T> nextQueue = 0;
+        bool stopping = false;
+
+        static inline thread_local const WorkerPool *currentPool = nullptr;
+        static inline thread_local SIZE_T currentWorker = 0;
+
+        inline void push(std::function<void()> task) {
+            auto queueIndex = currentPool == this ? currentWorker
+                                                  : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+            {
+                std::lock_guard lock(sleepMutex);
+                pendingTasks.fetch_add(1, std::memory_order_release);
+            }
+            {
+                std::lock_guard lock(queues[queueIndex]->mutex);
+                queues[queueIndex]->tasks.push_back(std::move(task));
+            }
+            wakeUp.notify_one();
+        }
+
+        inline bool runPendingTask() {
+            auto self = currentPool == this ? currentWorker : 0;
+            std::function<void()> task;
+            for (SIZE_T i = 0; i < queues.size() && !task; i++) {
+                auto &queue = *queues[(self + i) % queues.size()];
+                std::lock_guard lock(queue.mutex);
+                if (queue.tasks.empty()) {
+                    continue;
+                }
+                if (i == 0 && currentPool == this) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+            }
+            if (!task) {
+                return false;
+            }
+            pendingTasks.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            return true;
+        }
+
+        inline void workerLoop(SIZE_T index) {
+            currentPool = this;
+            currentWorker = index;
+            while (true) {
+                if (runPendingTask()) {
+                    continue;
+                }
+                std::unique_lock lock(sleepMutex);
+                wakeUp.wait(lock, [this] { return stopping || pendingTasks.load(std::memory_order_acquire) > 0; });
+                // Drain whatever was queued before shutting down, so no future is left without a value.
+                if (stopping && pendingTasks.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+            }
+        }
+    };
+
+    typedef std::shared_ptr<WorkerPool> SPWP;
+}
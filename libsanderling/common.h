@@ -7,8 +7,21 @@
 #define LOGURU_WITH_STREAMS 1
 
 #include <vector>
+#ifdef _WIN32
 #include <winsock2.h>
 #include <windows.h>
+#else
+#include <cstdint>
+#include <cstddef>
+// Win32 names used throughout the readers, so the non Windows backends share the same signatures.
+typedef uint32_t DWORD;
+typedef void *PVOID;
+typedef void *LPVOID;
+typedef const void *LPCVOID;
+typedef unsigned char byte;
+typedef byte *LPBYTE;
+typedef size_t SIZE_T;
+#endif
 #include <map>
 #include <memory>
 #include <vector>
@@ -19,6 +32,12 @@
 #include <boost/asio.hpp>
 #include <unordered_set>
 #include <type_traits>
+#include <span>
+#include <optional>
+#include <string_view>
+#include <cstring>
+#include <bit>
+#include <format>
 
 #include <iostream>
 
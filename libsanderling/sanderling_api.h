@@ -5,3 +5,6 @@
 #pragma once
 
 #include "EVEOnlineReader.h"
+#include "SyntheticHeap.h"
+#include "ReaderService.h"
+#include "SharedFrameRing.h"